@@ -0,0 +1,190 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "ifConvert.h"
+#include "../utils.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+namespace xVerilog {
+
+    static cl::opt<unsigned>
+    IfConvertThreshold("if_convert_threshold",
+            cl::desc("The largest cost of the instructions which are moved out of both sides of a branch"),
+            cl::value_desc("cost"), cl::init(8));
+
+    /// @return the block which 'side' jumps to unconditionally, NULL if none
+    static BasicBlock* getJump(BasicBlock* side) {
+        BranchInst* br = dyn_cast<BranchInst>(side->getTerminator());
+        if (!br || br->isConditional()) return NULL;
+        return br->getSuccessor(0);
+    }
+
+    bool IfConvertPass::isConvertibleSide(BasicBlock* side, BasicBlock* head, BasicBlock* join) {
+        // the empty side of a hammock
+        if (side == join) return true;
+        if (side == head || side->getSinglePredecessor() != head) return false;
+        if (getJump(side) != join) return false;
+
+        for (BasicBlock::iterator I = side->begin(), E = side->end(); I != E; ++I) {
+            if (isa<TerminatorInst>(I)) continue;
+            if (isa<PHINode>(I) || isa<CallInst>(I) || isa<AllocaInst>(I)) return false;
+            if (LoadInst* ld = dyn_cast<LoadInst>(I)) {
+                if (ld->isVolatile()) return false;
+            }
+            if (StoreInst* st = dyn_cast<StoreInst>(I)) {
+                if (st->isVolatile()) return false;
+                // predicated stores are declared for integers only
+                if (!st->getOperand(0)->getType()->isIntegerTy()) return false;
+            }
+        }
+        return true;
+    }
+
+    unsigned int IfConvertPass::getCost(BasicBlock* side) {
+        unsigned int cost = 0;
+        for (BasicBlock::iterator I = side->begin(), E = side->end(); I != E; ++I) {
+            if (isa<TerminatorInst>(I) || isa<CastInst>(I) || isa<GetElementPtrInst>(I)) {
+                // wires
+                continue;
+            }
+            switch (I->getOpcode()) {
+                case Instruction::Mul:
+                case Instruction::UDiv:
+                case Instruction::SDiv:
+                case Instruction::URem:
+                case Instruction::SRem:
+                    cost += 4;
+                    break;
+                case Instruction::Shl:
+                case Instruction::LShr:
+                case Instruction::AShr:
+                    // shifts by a constant are wires
+                    cost += isa<Constant>(I->getOperand(1)) ? 0 : 2;
+                    break;
+                case Instruction::Load:
+                case Instruction::Store:
+                    cost += 2;
+                    break;
+                default:
+                    cost += 1;
+            }
+        }
+        return cost;
+    }
+
+    Function* IfConvertPass::getPredicatedStore(Module* M, const Type* type) {
+        std::stringstream name;
+        name<<PredicatedStorePrefix<<"_i"<<cast<IntegerType>(type)->getBitWidth();
+        LLVMContext& context = M->getContext();
+        Constant* store = M->getOrInsertFunction(name.str(), Type::getVoidTy(context),
+                type, PointerType::getUnqual(type), Type::getInt1Ty(context), NULL);
+        return cast<Function>(store);
+    }
+
+    void IfConvertPass::hoistSide(BasicBlock* side, BasicBlock* head, Value* predicate) {
+        Instruction* br = head->getTerminator();
+        Module* M = head->getParent()->getParent();
+        for (BasicBlock::iterator I = side->begin(); &*I != side->getTerminator();) {
+            Instruction* inst = I++;
+            if (StoreInst* st = dyn_cast<StoreInst>(inst)) {
+                Value* args[3] = {st->getOperand(0), st->getOperand(1), predicate};
+                Function* store = getPredicatedStore(M, st->getOperand(0)->getType());
+                CallInst::Create(store, args, args+3, "", br);
+                st->eraseFromParent();
+            } else {
+                inst->moveBefore(br);
+            }
+        }
+    }
+
+    /// @return true if BB has a store
+    static bool hasStore(BasicBlock* BB) {
+        for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+            if (isa<StoreInst>(I)) return true;
+        }
+        return false;
+    }
+
+    bool IfConvertPass::convertBranch(BasicBlock* BB) {
+        BranchInst* br = dyn_cast<BranchInst>(BB->getTerminator());
+        if (!br || !br->isConditional()) return false;
+        BasicBlock* T = br->getSuccessor(0);
+        BasicBlock* F = br->getSuccessor(1);
+        if (T == F) return false;
+
+        // find where both sides meet
+        BasicBlock* join = NULL;
+        if (getJump(T) == F) {
+            join = F;           // if-then
+        } else if (getJump(F) == T) {
+            join = T;           // if-else
+        } else if (getJump(T) && getJump(T) == getJump(F)) {
+            join = getJump(T);  // if-then-else
+        } else {
+            return false;
+        }
+        if (join == BB) return false;
+
+        if (!isConvertibleSide(T, BB, join) || !isConvertibleSide(F, BB, join)) return false;
+        unsigned int cost = (T == join ? 0 : getCost(T)) + (F == join ? 0 : getCost(F));
+        if (cost > IfConvertThreshold) return false;
+
+        Value* cond = br->getCondition();
+        if (T != join) hoistSide(T, BB, cond);
+        if (F != join) {
+            Value* notCond = NULL;
+            if (hasStore(F)) notCond = BinaryOperator::CreateNot(cond, "not", br);
+            hoistSide(F, BB, notCond);
+        }
+
+        // the PHINodes of the join select the value of the side which ran
+        BasicBlock* fromT = (T == join) ? BB : T;
+        BasicBlock* fromF = (F == join) ? BB : F;
+        for (BasicBlock::iterator I = join->begin(); PHINode* phi = dyn_cast<PHINode>(I); ++I) {
+            Value* vT = phi->getIncomingValueForBlock(fromT);
+            Value* vF = phi->getIncomingValueForBlock(fromF);
+            Value* v = vT;
+            if (vT != vF) v = SelectInst::Create(cond, vT, vF, "select", br);
+            if (fromT != BB) phi->removeIncomingValue(fromT, false);
+            if (fromF != BB) phi->removeIncomingValue(fromF, false);
+            int idx = phi->getBasicBlockIndex(BB);
+            if (idx < 0) {
+                phi->addIncoming(v, BB);
+            } else {
+                phi->setIncomingValue(idx, v);
+            }
+        }
+
+        BranchInst::Create(join, br);
+        br->eraseFromParent();
+        if (T != join) T->eraseFromParent();
+        if (F != join) F->eraseFromParent();
+
+        // one block for the list scheduler to pack
+        MergeBlockIntoPredecessor(join, this);
+        return true;
+    }
+
+    bool IfConvertPass::runOnFunction(Function &F) {
+        bool changed = false;
+        // Converting a branch erases blocks, so start over after each one.
+        // Inner branches are converted first, their sides then become
+        // straight blocks of the outer branch.
+        bool converted = true;
+        while (converted) {
+            converted = false;
+            for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+                if (convertBranch(BB)) {
+                    converted = true;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        return changed;
+    }
+
+    char IfConvertPass::ID = 0;
+    RegisterPass<IfConvertPass> ICXX("if_convert", "if-convert small branches into selects and predicated stores");
+
+} //namespace
@@ -0,0 +1,102 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_IF_CONVERT_PASS_H
+#define LLVM_IF_CONVERT_PASS_H
+
+#include "llvm/Pass.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Constants.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/DerivedTypes.h"
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <map>
+
+using namespace llvm;
+
+using std::set;
+using std::map;
+using std::vector;
+using std::pair;
+using std::string;
+
+namespace xVerilog {
+
+    /*
+     * If-conversion of small hammocks (if-then) and diamonds (if-then-else).
+     * Every branch of the synthesized circuit costs at least one state and a
+     * jump, so the instructions of both sides of a small branch are moved
+     * into the block of the branch and run on every path. The PHINodes of
+     * the join become selects and a store is replaced by a predicated store,
+     * which drives the write enable of the memory port with the branch
+     * condition. The join is then merged into the block, so the list
+     * scheduler gets one straight block to pack.
+     */
+    class IfConvertPass : public FunctionPass {
+
+        public:
+            /// needed by LLVM
+            static char ID;
+            /**
+             * @brief C'tor in LLVM style
+             */
+            IfConvertPass() : FunctionPass(ID) {}
+
+            /**
+             * @param AU llvm analysis usage internal object
+             */
+            virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+            }
+
+            virtual bool runOnFunction(Function &F);
+
+        private:
+            /**
+             * @brief If-convert the branch at the end of BB, if it starts a
+             * hammock or a diamond which is cheap enough.
+             *
+             * @return True if the branch was converted
+             */
+            bool convertBranch(BasicBlock* BB);
+
+            /**
+             * @param side a successor of the branch block 'head'
+             * @param join the block where both sides meet
+             *
+             * @return True if 'side' is a block which only 'head' enters and
+             * which only runs instructions we can move into 'head'
+             */
+            static bool isConvertibleSide(BasicBlock* side, BasicBlock* head, BasicBlock* join);
+
+            /**
+             * @return the cost of running the instructions of 'side' on
+             * every path. Multi-cycle units and memory ports cost more.
+             */
+            static unsigned int getCost(BasicBlock* side);
+
+            /**
+             * @brief Move the instructions of 'side' before the branch of
+             * 'head'. Stores only write when 'predicate' is set.
+             */
+            static void hoistSide(BasicBlock* side, BasicBlock* head, Value* predicate);
+
+            /**
+             * @return a declaration of the predicated store for values of
+             * type 'type'
+             */
+            static Function* getPredicatedStore(Module* M, const Type* type);
+    }; // class
+
+
+
+} //end of namespace
+#endif // h guard
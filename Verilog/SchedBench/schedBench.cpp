@@ -0,0 +1,416 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+//
+// sched-bench: a micro benchmark of the scheduler.
+//
+// Generates synthetic basic blocks of growing size and times each phase of
+// the backend on them: the instruction priority, the lowering into opcodes,
+// the dependencies between the opcodes, the placement and the verilog
+// emission. The growth of the time of a phase from one size to the next
+// shows quadratic phases before a large design hits them.
+//
+//   sched-bench -sizes=1000,10000,100000 -mul-percent=20 -arrays=4
+//
+// The units are configured with the flags of llc (-units_mul=2 ...). The
+// flags which are not given take the values of vcc.sh.
+//
+
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Config/config.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+#if defined(HAVE_SYS_RESOURCE_H)
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#include "../Synthesis/listScheduler.h"
+#include "../Synthesis/instPriority.h"
+#include "../Synthesis/verilogLang.h"
+#include "../Synthesis/designScorer.h"
+#include "../Synthesis/schedulingArena.h"
+#include "../Synthesis/schedulingEngine.h"
+#include "../Synthesis/globalVarsRegistry.h"
+#include "../params.h"
+
+using namespace llvm;
+using namespace xVerilog;
+
+static cl::list<unsigned>
+Sizes("sizes", cl::desc("the number of instructions of each generated block (default 100,1000,10000,100000)"),
+        cl::value_desc("num,num,..."), cl::CommaSeparated);
+
+static cl::opt<unsigned>
+FanIn("fanin", cl::desc("the number of values each operation combines"),
+        cl::value_desc("num"), cl::init(2));
+
+static cl::opt<unsigned>
+FanOut("fanout", cl::desc("the largest number of users of a value"),
+        cl::value_desc("num"), cl::init(2));
+
+static cl::opt<unsigned>
+Window("window", cl::desc("operands come from the last 'window' values, small windows make long chains"),
+        cl::value_desc("num"), cl::init(16));
+
+static cl::opt<unsigned>
+MulPercent("mul-percent", cl::desc("the percent of the operations which multiply"),
+        cl::value_desc("percent"), cl::init(10));
+
+static cl::opt<unsigned>
+DivPercent("div-percent", cl::desc("the percent of the operations which divide"),
+        cl::value_desc("percent"), cl::init(2));
+
+static cl::opt<unsigned>
+LoadPercent("load-percent", cl::desc("the percent of the operations which load"),
+        cl::value_desc("percent"), cl::init(15));
+
+static cl::opt<unsigned>
+StorePercent("store-percent", cl::desc("the percent of the operations which store"),
+        cl::value_desc("percent"), cl::init(10));
+
+static cl::opt<unsigned>
+Arrays("arrays", cl::desc("the number of memory arrays, each one has its own port"),
+        cl::value_desc("num"), cl::init(2));
+
+static cl::opt<unsigned>
+Seed("seed", cl::desc("the seed of the generator"), cl::value_desc("num"), cl::init(1));
+
+static cl::opt<schedulerKind>
+Engine("engine", cl::desc("the algorithm which places the opcodes"),
+        cl::values(
+            clEnumValN(ListScheduling, "list", "greedy list scheduling (default)"),
+            clEnumValN(ForceDirectedScheduling, "fds", "force directed scheduling"),
+            clEnumValEnd),
+        cl::init(ListScheduling));
+
+static cl::opt<priorityKind>
+Priority("priority", cl::desc("the order in which the opcodes are scheduled"),
+        cl::values(
+            clEnumValN(BFSPriority, "bfs", "depth from the end of the block"),
+            clEnumValN(CriticalPathPriority, "critical", "latency weighted critical path (default)"),
+            clEnumValEnd),
+        cl::init(CriticalPathPriority));
+
+static cl::opt<double>
+MaxExponent("max-exponent", cl::desc("fail if the time of a phase grows faster than size^exponent"),
+        cl::value_desc("exponent"), cl::init(0));
+
+namespace {
+
+    /// the phases of the backend which are timed
+    enum benchPhase {
+        PriorityPhase,
+        LoweringPhase,
+        DependencyPhase,
+        PlacementPhase,
+        EmissionPhase,
+        NumPhases
+    };
+
+    const char* const PhaseNames[NumPhases] = {
+        "priority", "lowering", "dependencies", "placement", "emission"
+    };
+
+    /// The measurements of one block
+    struct benchResult {
+        unsigned int insts;
+        unsigned int states;
+        /// microseconds of each phase
+        uint64_t usec[NumPhases];
+        size_t arenaBytes;
+        /// the peak resident size of the process so far, in KB
+        long peakKB;
+    };
+
+    /// xorshift, so the blocks are the same on every host
+    class randomGenerator {
+        public:
+            randomGenerator(uint64_t seed):m_state(seed * 2654435761ULL + 1) {}
+            unsigned int next(unsigned int range) {
+                m_state ^= m_state << 13;
+                m_state ^= m_state >> 7;
+                m_state ^= m_state << 17;
+                return (unsigned int)(m_state % range);
+            }
+        private:
+            uint64_t m_state;
+    };
+
+    /*
+     * Builds the block, one operation at a time. The values which may still
+     *  be used are in a pool, the operands are picked from its end.
+     */
+    class blockGenerator {
+        public:
+            blockGenerator(Function* F, randomGenerator& rnd):m_rnd(rnd),m_count(0) {
+                m_BB = BasicBlock::Create(F->getContext(), "entry", F);
+                for (Function::arg_iterator I = F->arg_begin(), E = F->arg_end(); I != E; ++I) {
+                    if (I->getType()->isPointerTy()) m_arrays.push_back(I); else m_args.push_back(I);
+                }
+            }
+
+            /// Append operations until the block has 'size' instructions
+            void generate(unsigned int size) {
+                while (m_count < size) {
+                    unsigned int r = m_rnd.next(100);
+                    if (r < MulPercent) {
+                        addValue(combine(Instruction::Mul));
+                    } else if ((r -= MulPercent) < DivPercent) {
+                        addValue(combine(Instruction::SDiv));
+                    } else if ((r -= DivPercent) < LoadPercent) {
+                        addValue(new LoadInst(getAddress(), name(), m_BB));
+                        m_count++;
+                    } else if ((r -= LoadPercent) < StorePercent) {
+                        Value* val = pickOperand();
+                        new StoreInst(val, getAddress(), m_BB);
+                        m_count++;
+                    } else {
+                        static const Instruction::BinaryOps alu[] = {
+                            Instruction::Add, Instruction::Sub, Instruction::Xor,
+                            Instruction::And, Instruction::Or };
+                        addValue(combine(alu[m_rnd.next(5)]));
+                    }
+                }
+                ReturnInst::Create(m_BB->getContext(), m_BB);
+            }
+
+            BasicBlock* getBlock() { return m_BB; }
+
+        private:
+            string name() { return "v" + utostr(m_count); }
+
+            /// @return an operand, which is used once more
+            Value* pickOperand() {
+                if (m_pool.empty()) return m_args[m_rnd.next(m_args.size())];
+                unsigned int window = std::min((unsigned int)m_pool.size(), std::max(1U, (unsigned int)Window));
+                unsigned int i = m_pool.size() - 1 - m_rnd.next(window);
+                Value* val = m_pool[i].first;
+                if (0 == --m_pool[i].second) {
+                    // the last entry is in the window too
+                    m_pool[i] = m_pool.back();
+                    m_pool.pop_back();
+                }
+                return val;
+            }
+
+            /// @return 'op' over fanin operands, a chain of adds after the first two
+            Value* combine(Instruction::BinaryOps op) {
+                Value* lhs = pickOperand();
+                Value* rhs = (FanIn > 1) ? pickOperand() :
+                    ConstantInt::get(lhs->getType(), 3);
+                Value* val = BinaryOperator::Create(op, lhs, rhs, name(), m_BB);
+                m_count++;
+                for (unsigned int i = 2; i < FanIn; ++i) {
+                    val = BinaryOperator::Create(Instruction::Add, val, pickOperand(), name(), m_BB);
+                    m_count++;
+                }
+                return val;
+            }
+
+            /// @return the address of an element of a random array
+            Value* getAddress() {
+                Value* array = m_arrays[m_rnd.next(m_arrays.size())];
+                Value* index = pickOperand();
+                Value* gep = GetElementPtrInst::Create(array, index, name(), m_BB);
+                m_count++;
+                return gep;
+            }
+
+            void addValue(Value* val) {
+                if (FanOut) m_pool.push_back(std::make_pair(val, (unsigned int)FanOut));
+            }
+
+            randomGenerator& m_rnd;
+            BasicBlock* m_BB;
+            vector<Value*> m_arrays;
+            vector<Value*> m_args;
+            /// the values which may still be used, and how many more times
+            vector<std::pair<Value*, unsigned int> > m_pool;
+            unsigned int m_count;
+    };
+
+    /// @return a module with the function bench(mem0, mem1, ..., a, b)
+    Module* generateModule(LLVMContext& context, unsigned int size, randomGenerator& rnd) {
+        Module* M = new Module("bench", context);
+        const Type* i32 = Type::getInt32Ty(context);
+        vector<const Type*> params(std::max(1U, (unsigned int)Arrays), PointerType::getUnqual(i32));
+        params.push_back(i32);
+        params.push_back(i32);
+        FunctionType* FT = FunctionType::get(Type::getVoidTy(context), params, false);
+        Function* F = Function::Create(FT, Function::ExternalLinkage, "bench", M);
+
+        unsigned int arg = 0;
+        for (Function::arg_iterator I = F->arg_begin(), E = F->arg_end(); I != E; ++I, ++arg) {
+            if (arg + 2 < params.size()) I->setName("mem" + utostr(arg));
+            else I->setName(arg + 2 == params.size() ? "a" : "b");
+        }
+
+        blockGenerator(F, rnd).generate(size);
+        return M;
+    }
+
+    long getPeakMemoryKB() {
+#if defined(HAVE_SYS_RESOURCE_H)
+        struct rusage usage;
+        if (0 == getrusage(RUSAGE_SELF, &usage)) return usage.ru_maxrss;
+#endif
+        return 0;
+    }
+
+    uint64_t elapsed(const sys::TimeValue& start) {
+        return (sys::TimeValue::now() - start).usec();
+    }
+
+    /// Generate a block of 'size' instructions and time the phases on it
+    benchResult runBenchmark(unsigned int size, const resourceConfig& config,
+            const schedulingEngine& engine) {
+        LLVMContext& context = getGlobalContext();
+        randomGenerator rnd(Seed + size);
+        Module* M = generateModule(context, size, rnd);
+        BasicBlock* BB = &M->getFunction("bench")->front();
+        TargetData TD(M);
+        globalVarRegistry gvr;
+        gvr.init(M);
+
+        benchResult result;
+        result.insts = BB->size();
+
+        // the priority on its own. The lowering computes it again.
+        sys::TimeValue start = sys::TimeValue::now();
+        {
+            instructionPriority prioritizer(BB);
+            if (BFSPriority == Priority) {
+                prioritizer.getOrderedInstructions();
+            } else {
+                instructionPriority::InstPriorityMap lengths;
+                for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) lengths[I] = 1;
+                prioritizer.getCriticalPathOrder(lengths);
+            }
+        }
+        result.usec[PriorityPhase] = elapsed(start);
+
+        schedulingArena arena;
+        start = sys::TimeValue::now();
+        listScheduler* ls = arena.create<listScheduler>(BB,&TD,&arena,config,(priorityKind)Priority);
+        result.usec[LoweringPhase] = elapsed(start);
+
+        start = sys::TimeValue::now();
+        ls->computeDependencies();
+        result.usec[DependencyPhase] = elapsed(start);
+
+        start = sys::TimeValue::now();
+        ls->scheduleBasicBlock(engine);
+        result.usec[PlacementPhase] = elapsed(start);
+
+        start = sys::TimeValue::now();
+        {
+            xVerilog::verilogLanguage printer(M, NULL, &TD, config);
+            listSchedulerVector lv(1, ls);
+            string verilog = printer.getFunctionLocalVariables(lv);
+            verilog += printer.getStateDefs(lv);
+            verilog += printer.getAssignmentString(lv);
+            verilog += printer.printBasicBlockDatapath(ls);
+            verilog += printer.printBasicBlockControl(ls);
+        }
+        result.usec[EmissionPhase] = elapsed(start);
+
+        result.states = ls->getStateCount();
+        result.arenaBytes = arena.getBytesAllocated();
+        result.peakKB = getPeakMemoryKB();
+
+        arena.reset();
+        gvr.destroy();
+        delete M;
+        return result;
+    }
+
+    /// the fields of the configuration which were not given, as in vcc.sh
+    void setDefaults(resourceConfig& config) {
+        if (!config.units_mul) config.units_mul = 4;
+        if (!config.units_div) config.units_div = 1;
+        if (!config.units_memport) config.units_memport = 1;
+        if (!config.units_shl) config.units_shl = 1;
+        if (!config.delay_mul) config.delay_mul = 5;
+        if (!config.delay_div) config.delay_div = 5;
+        if (!config.delay_memport) config.delay_memport = 1;
+        if (!config.delay_shl) config.delay_shl = 5;
+        if (!config.mem_wordsize) config.mem_wordsize = 32;
+        if (!config.membus_size) config.membus_size = 16;
+    }
+
+    double perSecond(unsigned int insts, uint64_t usec) {
+        return insts * 1e6 / std::max((uint64_t)1, usec);
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    llvm_shutdown_obj Y;
+    cl::ParseCommandLineOptions(argc, argv, "scheduler micro benchmark\n");
+
+    vector<unsigned int> sizes(Sizes.begin(), Sizes.end());
+    if (sizes.empty()) {
+        sizes.push_back(100);
+        sizes.push_back(1000);
+        sizes.push_back(10000);
+        sizes.push_back(100000);
+    }
+    if (!Arrays && (LoadPercent || StorePercent)) {
+        std::cerr<<"Loads and stores need at least one array\n";
+        return 1;
+    }
+
+    resourceConfig config = machineResourceConfig::getResourceConfig();
+    setDefaults(config);
+    designScorer::fitPipelineDepths(config);
+    schedulingEngine* engine = schedulingEngine::create(Engine);
+
+    vector<benchResult> results;
+    bool failed = false;
+    std::cout<<std::fixed<<std::setprecision(1);
+    for (unsigned int s = 0; s < sizes.size(); ++s) {
+        benchResult r = runBenchmark(sizes[s], config, *engine);
+        results.push_back(r);
+
+        uint64_t total = 0;
+        for (unsigned int p = 0; p < NumPhases; ++p) total += r.usec[p];
+
+        std::cout<<"\n--- "<<r.insts<<" instructions, "<<r.states<<" states ---\n";
+        for (unsigned int p = 0; p < NumPhases; ++p) {
+            std::cout<<std::left<<std::setw(14)<<PhaseNames[p]<<std::right
+                <<std::setw(12)<<r.usec[p]/1000.0<<" ms "
+                <<std::setw(14)<<perSecond(r.insts, r.usec[p])<<" insts/s";
+            // the growth since the previous size, 1 is linear and 2 is quadratic
+            if (s > 0 && results[s-1].usec[p] > 0 && r.usec[p] > 0 && r.insts > results[s-1].insts) {
+                double exponent = log((double)r.usec[p] / results[s-1].usec[p]) /
+                    log((double)r.insts / results[s-1].insts);
+                std::cout<<"   size^"<<std::setprecision(2)<<exponent<<std::setprecision(1);
+                if (MaxExponent > 0 && exponent > MaxExponent) {
+                    std::cout<<" (too slow)";
+                    failed = true;
+                }
+            }
+            std::cout<<"\n";
+        }
+        std::cout<<std::left<<std::setw(14)<<"total"<<std::right
+            <<std::setw(12)<<total/1000.0<<" ms "
+            <<std::setw(14)<<perSecond(r.insts, total)<<" insts/s\n";
+        std::cout<<"arena "<<r.arenaBytes/1024<<" KB, peak resident "<<r.peakKB<<" KB\n";
+    }
+
+    delete engine;
+    return failed ? 1 : 0;
+}
@@ -42,10 +42,21 @@
 #include "llvm/MC/MCAsmInfo.h"
 #include "llvm/MC/MCContext.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/InstIterator.h"
 
 #include "listScheduler.h"
 #include "verilogLang.h"
 #include "designScorer.h"
+#include "schedulingArena.h"
+#include "workQueue.h"
+#include "scheduleCache.h"
+#include "schedulingEngine.h"
+#include "exactSchedulingEngine.h"
+#include "moduloScheduler.h"
+#include "superblock.h"
+#include "designSpaceExplorer.h"
+#include "backendStats.h"
+#include "scheduleTrace.h"
 #include "../params.h"
 
 using namespace llvm;
@@ -61,6 +72,129 @@ extern "C" void LLVMInitializeVerilogTarget() {
 
 namespace xVerilog {
 
+static cl::opt<unsigned>
+SchedThreads("sched-threads", cl::desc("number of threads used for scheduling basic blocks and functions"),
+        cl::value_desc("num"), cl::init(1));
+
+static cl::opt<std::string>
+TopFunction("top-function", cl::desc("synthesize only this function and the functions it calls"),
+        cl::value_desc("name"), cl::init(""));
+
+static cl::opt<std::string>
+ModuleDir("module-dir", cl::desc("write each function into its own .v file in this directory"),
+        cl::value_desc("dir"), cl::init(""));
+
+static cl::opt<std::string>
+SchedCacheDir("sched-cache-dir", cl::desc("reuse the schedules of basic blocks stored in this directory"),
+        cl::value_desc("dir"), cl::init(""));
+
+static cl::opt<schedulerKind>
+Scheduler("scheduler", cl::desc("the algorithm which schedules the basic blocks"),
+        cl::values(
+            clEnumValN(ListScheduling, "list", "greedy list scheduling (default)"),
+            clEnumValN(ForceDirectedScheduling, "fds", "force directed scheduling"),
+            clEnumValEnd),
+        cl::init(ListScheduling));
+
+static cl::opt<priorityKind>
+SchedPriority("sched-priority", cl::desc("the order in which the opcodes of a block are scheduled"),
+        cl::values(
+            clEnumValN(BFSPriority, "bfs", "depth from the end of the block"),
+            clEnumValN(CriticalPathPriority, "critical", "latency weighted critical path, then mobility (default)"),
+            clEnumValEnd),
+        cl::init(CriticalPathPriority));
+
+static cl::opt<bool>
+ExactSched("exact-sched", cl::desc("search for the shortest schedule of small loop blocks"),
+        cl::init(false));
+
+static cl::opt<unsigned>
+ExactMaxOps("exact-max-ops", cl::desc("the largest loop block the exact scheduler searches"),
+        cl::value_desc("opcodes"), cl::init(32));
+
+static cl::opt<unsigned>
+ExactBudget("exact-budget-ms", cl::desc("time budget of the exact scheduler for each block"),
+        cl::value_desc("ms"), cl::init(100));
+
+static cl::opt<bool>
+ModuloSched("modulo-sched", cl::desc("pipeline loops of a single basic block"),
+        cl::init(false));
+
+static cl::opt<bool>
+Superblocks("superblocks", cl::desc("schedule the likely paths through blocks as superblocks"),
+        cl::init(false));
+
+static cl::opt<unsigned>
+SuperblockMaxBlocks("superblock-max-blocks", cl::desc("the number of blocks in the longest superblock"),
+        cl::value_desc("blocks"), cl::init(4));
+
+static cl::opt<bool>
+DSE("dse-explore", cl::desc("sweep the unit counts and pipeline depths and emit the best design"),
+        cl::init(false));
+
+static cl::list<unsigned>
+DSEUnits("dse-units", cl::desc("the unit counts the design space exploration tries (default 1,2,4)"),
+        cl::value_desc("num,num,..."), cl::CommaSeparated);
+
+static cl::list<unsigned>
+DSEDelays("dse-delays", cl::desc("the pipeline depths the design space exploration tries (default 1,3,5)"),
+        cl::value_desc("num,num,..."), cl::CommaSeparated);
+
+static cl::opt<unsigned>
+DSEWorkers("dse-workers", cl::desc("number of processes which evaluate design points at once"),
+        cl::value_desc("num"), cl::init(1));
+
+static cl::opt<std::string>
+DSEReport("dse-report", cl::desc("write the Pareto frontier of the design space exploration to this JSON file"),
+        cl::value_desc("file"), cl::init("dse.json"));
+
+/// The context of scheduleBlockJob
+struct scheduleContext {
+    listSchedulerVector* blocks;
+    /// the engine of each block
+    vector<schedulingEngine*>* engines;
+    /// the cache key of each block, empty if there is no cache. A block
+    /// with an empty key is not cached.
+    vector<string>* keys;
+    /// may be NULL
+    scheduleCache* cache;
+    /// set to 1 for each block which was found in the cache
+    vector<char>* hits;
+    /// modulo schedule the single block loops
+    bool pipeline;
+};
+
+/// Schedule one basic block of the scheduleContext, or replay its cached schedule
+static void scheduleBlockJob(unsigned int job, void* context) {
+    scheduleContext* ctx = static_cast<scheduleContext*>(context);
+    listScheduler* ls = (*ctx->blocks)[job];
+    schedulingEngine* engine = (*ctx->engines)[job];
+    if (!ctx->cache || (*ctx->keys)[job].empty()) {
+        ls->scheduleBasicBlock(*engine);
+    } else {
+        const string& key = (*ctx->keys)[job];
+        SchedulePlacement placement;
+        unsigned int heuristicLength = 0;
+        if (ctx->cache->load(key, placement, heuristicLength) && ls->replaySchedule(placement)) {
+            // the exact scheduler may have improved on the heuristic
+            ls->setHeuristicLength(heuristicLength);
+            (*ctx->hits)[job] = 1;
+        } else {
+            ls->scheduleBasicBlock(*engine);
+            ctx->cache->store(key, ls->getSchedulePlacement(), ls->getHeuristicLength());
+        }
+    }
+
+    // The cache holds the list schedule, the loop is pipelined on top of it.
+    if (ctx->pipeline && moduloScheduler::isSingleBlockLoop(ls->getBB())) {
+        moduloScheduler(ls).schedule();
+    }
+
+    // The schedule is final, group its instructions by cycle for the
+    // emitters and the scorer while the block is still on this thread
+    ls->getScheduleView();
+}
+
 //ASMInfo
 class VBEMCAsmInfo : public MCAsmInfo {
   public:
@@ -70,15 +204,40 @@ class VBEMCAsmInfo : public MCAsmInfo {
   }
 };
 
+    /*
+     * The state of a single function while the VWriter compiles it.
+     */
+    struct functionJob {
+        functionJob(Function* func):F(func),TD(func->getParent()) {}
+        Function* F;
+        /// each function has its own TargetData, its layout cache is not shared
+        TargetData TD;
+        /// the blocks of F which are inside a loop
+        BasicBlockSet loopBlocks;
+        /// owns all of the scheduling objects of this function
+        schedulingArena arena;
+        /// the scheduled blocks of F
+        listSchedulerVector lv;
+        /// the engine which schedules each block of lv
+        vector<schedulingEngine*> engines;
+        /// the schedule cache key of each block of lv, if the cache is used
+        vector<string> cacheKeys;
+        /// the synthesis report, printed to stderr
+        string report;
+        /// the verilog module and its test bench
+        string verilog;
+    };
+
+    typedef vector<functionJob*> functionJobVector;
   
     /// VWriter - This class is the main chunk of code that converts an LLVM
     /// module to a Verilog translation unit.
-    class VWriter : public FunctionPass {
+    class VWriter : public ModulePass {
 
         public:
             static char ID;
             VWriter(llvm::formatted_raw_ostream &o) 
-                : FunctionPass(ID),Out(o) {
+                : ModulePass(ID),Out(o) {
               initializeLoopInfoPass(*PassRegistry::getPassRegistry());
             }
 
@@ -91,24 +250,151 @@ class VBEMCAsmInfo : public MCAsmInfo {
                 //AU.setPreservesAll();
             }
 
-            virtual bool doInitialization(Module &M);
-            virtual bool doFinalization(Module &M);
+            bool runOnModule(Module &M);
 
-            bool runOnFunction(Function &F);
+            /*
+             * Write the verilog module of a lowered function into job->verilog.
+             *  Only reads the IR, so functions may be emitted in parallel.
+             */
+            void emitFunction(functionJob* job);
+
+            /*
+             * Lower, schedule and score the functions with the configuration
+             *  'config'. This modifies the IR, it runs in the processes of
+             *  the design space exploration.
+             */
+            designCost evaluateDesign(const vector<Function*>& functions, const resourceConfig& config);
 
         private:
+            void initialize(Module &M);
+            void finalize();
+
+            /*
+             * @return the functions to synthesize, in module order. Either all of
+             *  the functions or the top function and every function it calls.
+             */
+            vector<Function*> getSelectedFunctions(Module &M);
+
+            /*
+             * Sweep the configurations of the units which the functions use
+             *  and keep the best one in m_config. Writes the DSE report.
+             */
+            void exploreDesignSpace(const vector<Function*>& functions);
+
+            /*
+             * Lower all of the blocks of the function into abstract opcodes. This
+             *  modifies the IR and must run on one function at a time.
+             */
+            void lowerFunction(functionJob* job);
+
+            /*
+             * @return the mul/div/shl units and the memory, emitted once per design
+             */
+            string getLibraryComponents();
+
+            /*
+             * Write 'text' to the file 'name' in the module directory
+             */
+            void writeModuleFile(const string& name, const string& text);
+
             llvm::formatted_raw_ostream &Out;
             Mangler *Mang;
       MCAsmInfo *tAI;
       MCContext *tCtx;
       TargetData *TD;
+      /// the configuration of the execution units, read once
+      resourceConfig m_config;
+      /// the algorithm which places the opcodes of every block
+      schedulingEngine* m_engine;
+      /// the algorithm for small loop blocks, NULL if not used
+      schedulingEngine* m_exactEngine;
+      /// the schedules of all of the blocks, NULL unless -sched-trace was given
+      scheduleTrace* m_trace;
+    };
+
+    /// The context of emitFunctionJob
+    struct emitContext {
+        VWriter* writer;
+        functionJobVector* jobs;
     };
 
+    /// Emit one function of the functionJobVector in the context
+    static void emitFunctionJob(unsigned int job, void* context) {
+        emitContext* ctx = static_cast<emitContext*>(context);
+        ctx->writer->emitFunction((*ctx->jobs)[job]);
+    }
+
+    /// The context of evaluateDesignJob
+    struct exploreContext {
+        VWriter* writer;
+        const vector<Function*>* functions;
+    };
+
+    /// Evaluate one point of the design space exploration
+    static designCost evaluateDesignJob(const resourceConfig& config, void* context) {
+        exploreContext* ctx = static_cast<exploreContext*>(context);
+        return ctx->writer->evaluateDesign(*ctx->functions, config);
+    }
+
+    static const char* getFileHeader() {
+	return  "/*       This module was generated by c-to-verilog.com\n"
+		" * THIS SOFTWARE IS PROVIDED BY www.c-to-verilog.com ''AS IS'' AND ANY\n"
+		" * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED\n"
+		" * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE\n"
+		" * DISCLAIMED. IN NO EVENT SHALL c-to-verilog.com BE LIABLE FOR ANY\n"
+		" * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES\n"
+		" * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES)\n"
+		" * \n"
+		" * Found a bug? email info@c-to-verilog.com \n"
+		" */\n\n\n";
+    }
 
 
     char VWriter::ID = 0;
 
-    bool VWriter::runOnFunction(Function &F) { 
+    vector<Function*> VWriter::getSelectedFunctions(Module &M) {
+        vector<Function*> selected;
+
+        if (TopFunction.empty()) {
+            for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+                if (!F->isDeclaration()) selected.push_back(F);
+            }
+            return selected;
+        }
+
+        Function* top = M.getFunction(TopFunction);
+        if (!top || top->isDeclaration()) {
+            std::cerr<<"Unable to find the top function "<<TopFunction<<"\n";
+            abort();
+        }
+
+        // collect every function which is reachable from the top function
+        set<Function*> reachable;
+        vector<Function*> worklist;
+        reachable.insert(top);
+        worklist.push_back(top);
+        while (!worklist.empty()) {
+            Function* F = worklist.back();
+            worklist.pop_back();
+            for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+                if (CallInst* call = dyn_cast<CallInst>(&*I)) {
+                    Function* callee = call->getCalledFunction();
+                    if (callee && !callee->isDeclaration() && reachable.insert(callee).second) {
+                        worklist.push_back(callee);
+                    }
+                }
+            }
+        }
+
+        // keep the module order so the output is stable
+        for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+            if (reachable.count(F)) selected.push_back(F);
+        }
+        return selected;
+    }
+
+    void VWriter::lowerFunction(functionJob* job) {
+        Function &F = *job->F;
         for (Function::arg_iterator I = F.arg_begin(), E = F.arg_end(); I != E; ++I) { //JAWAD
                 string argname = I->getName(); 
 		argname = machineResourceConfig::chrsubst(argname,'.','_');
@@ -120,106 +406,413 @@ class VBEMCAsmInfo : public MCAsmInfo {
 
         //std::cerr<<"Converting to verilog this function:\n" <<F<<"\n\n";
 
- 	//TargetData * TD =  &getAnalysis<TargetData>();//JAWAD
-        TargetData TD(F.getParent());
-        verilogLanguage verilogPrinter(F.getParent(),Mang,&TD);
+        // Take what we need from the LoopInfo now. The analysis of the
+        // next function replaces it.
+        LoopInfo &LInfo = getAnalysis<LoopInfo>(F);
+        for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+            if (LInfo.getLoopFor(BB)) job->loopBlocks.insert(BB);
+        }
 
-        listSchedulerVector lv;
+        // Each block is scheduled alone, unless it is in a superblock
+        vector<BasicBlockTrace> traces;
+        if (Superblocks) {
+            traces = superblockFormation(&LInfo, SuperblockMaxBlocks).formTraces(F);
+        } else {
+            for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+                traces.push_back(BasicBlockTrace(1, BB));
+            }
+        }
 
-	Out<<   "/*       This module was generated by c-to-verilog.com\n"
-		" * THIS SOFTWARE IS PROVIDED BY www.c-to-verilog.com ''AS IS'' AND ANY\n"
-		" * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED\n"
-		" * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE\n"
-		" * DISCLAIMED. IN NO EVENT SHALL c-to-verilog.com BE LIABLE FOR ANY\n"
-		" * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES\n"
-		" * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES)\n"
-		" * \n"
-		" * Found a bug? email info@c-to-verilog.com \n"
-		" */\n\n\n";
+        // Lowering modifies the IR and the global registry, do it one block at
+        // a time, in order.
+        for (unsigned int i = 0; i < traces.size(); ++i) {
+            BasicBlock* BB = traces[i].front();
+            schedulingEngine* engine = m_engine;
+            if (m_exactEngine && job->loopBlocks.count(BB)) engine = m_exactEngine;
+            job->engines.push_back(engine);
+
+            if (1 == traces[i].size()) {
+                if (!SchedCacheDir.empty()) {
+                    string options = engine->getName() +
+                        (BFSPriority == SchedPriority ? "/bfs" : "/critical");
+                    job->cacheKeys.push_back(scheduleCache::getBlockKey(BB, &job->TD, m_config, options));
+                }
+                listScheduler *ls = job->arena.create<listScheduler>(BB,&job->TD,&job->arena,m_config,
+                        (priorityKind)SchedPriority); //JAWAD
+                job->lv.push_back(ls);
+            } else {
+                // superblocks are not cached
+                if (!SchedCacheDir.empty()) job->cacheKeys.push_back("");
+                listScheduler *ls = job->arena.create<listScheduler>(traces[i],&job->TD,&job->arena,m_config,
+                        (priorityKind)SchedPriority);
+                job->lv.push_back(ls);
+            }
+        }
+    }
 
+    designCost VWriter::evaluateDesign(const vector<Function*>& functions, const resourceConfig& config) {
+        m_config = config;
+        designCost cost;
+        cost.clocks = 0;
+        cost.gates = 0;
+        cost.delay = 0;
+        for (unsigned int i = 0; i < functions.size(); ++i) {
+            functionJob job(functions[i]);
+            lowerFunction(&job);
+
+            vector<char> hits(job.lv.size(), 0);
+            scheduleContext sctx;
+            sctx.blocks = &job.lv;
+            sctx.engines = &job.engines;
+            sctx.keys = &job.cacheKeys;
+            sctx.cache = NULL;
+            sctx.hits = &hits;
+            sctx.pipeline = ModuloSched;
+            for (unsigned int b = 0; b < job.lv.size(); ++b) {
+                scheduleBlockJob(b, &sctx);
+            }
 
-        LoopInfo *LInfo = &getAnalysis<LoopInfo>();
-        designScorer ds(LInfo);
+            designScorer ds(job.loopBlocks, m_config);
+            for (listSchedulerVector::iterator it=job.lv.begin(); it!=job.lv.end(); ++it) {
+                ds.addListScheduler(*it);
+            }
+            cost.clocks += ds.getDesignClocks();
+            cost.gates += ds.getDesignSizeInGates(functions[i]);
+            cost.delay = std::max(cost.delay, ds.getDesignFrequency());
+        }
+        return cost;
+    }
 
-        for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
-            listScheduler *ls = new listScheduler(BB,&TD); //JAWAD
-            lv.push_back(ls);
-            ds.addListScheduler(ls);
+    /// The execution units which the functions need
+    struct unitUsage {
+        unitUsage():mul(false),div(false),shl(false),mem(false) {}
+        bool mul, div, shl, mem;
+    };
+
+    /// @return the kinds of units which the lowering of the functions uses
+    static unitUsage getUnitUsage(const vector<Function*>& functions) {
+        unitUsage usage;
+        for (unsigned int i = 0; i < functions.size(); ++i) {
+            for (inst_iterator I = inst_begin(functions[i]), E = inst_end(functions[i]); I != E; ++I) {
+                Instruction* inst = &*I;
+                if (Instruction::Mul == inst->getOpcode()) usage.mul = true;
+                if (Instruction::SDiv == inst->getOpcode()) usage.div = true;
+                // shifts by a constant are wires
+                if (Instruction::Shl == inst->getOpcode() && !isa<Constant>(inst->getOperand(1))) usage.shl = true;
+                if (isa<LoadInst>(inst) || isa<StoreInst>(inst) || isPredicatedStore(inst)) usage.mem = true;
+            }
+        }
+        return usage;
+    }
+
+    void VWriter::exploreDesignSpace(const vector<Function*>& functions) {
+        vector<unsigned int> units(DSEUnits.begin(), DSEUnits.end());
+        vector<unsigned int> delays(DSEDelays.begin(), DSEDelays.end());
+        if (units.empty()) {
+            units.push_back(1);
+            units.push_back(2);
+            units.push_back(4);
+        }
+        if (delays.empty()) {
+            delays.push_back(1);
+            delays.push_back(3);
+            delays.push_back(5);
+        }
+
+        // Only sweep the units which the design uses, the others do not
+        // change the schedule. The memory latency is not a design choice.
+        designSpaceExplorer explorer(m_config);
+        unitUsage usage = getUnitUsage(functions);
+        if (usage.mem) {
+            explorer.addDimension("units_memport", &resourceConfig::units_memport, units);
+        }
+        if (usage.mul) {
+            explorer.addDimension("units_mul", &resourceConfig::units_mul, units);
+            explorer.addDimension("delay_mul", &resourceConfig::delay_mul, delays);
+        }
+        if (usage.div) {
+            explorer.addDimension("units_div", &resourceConfig::units_div, units);
+            explorer.addDimension("delay_div", &resourceConfig::delay_div, delays);
+        }
+        if (usage.shl) {
+            explorer.addDimension("units_shl", &resourceConfig::units_shl, units);
+            explorer.addDimension("delay_shl", &resourceConfig::delay_shl, delays);
+        }
+
+        exploreContext ctx;
+        ctx.writer = this;
+        ctx.functions = &functions;
+        explorer.explore(evaluateDesignJob, &ctx, DSEWorkers);
+
+        std::string error;
+        raw_fd_ostream report(DSEReport.c_str(), error);
+        if (!error.empty()) {
+            std::cerr<<"Unable to write "<<DSEReport<<": "<<error<<"\n";
+            abort();
+        }
+        report<<explorer.getJSON();
+
+        const designPoint* best = explorer.getBestPoint();
+        if (!best) {
+            std::cerr<<"None of the "<<explorer.getNumPoints()<<" design points could be evaluated\n";
+            abort();
         }
+        std::cerr<<"DSE: "<<explorer.getNumPoints()<<" points, "<<explorer.getNumFailed()<<" failed. Picked "
+            <<explorer.describe(*best)<<"\n";
+        m_config = best->config;
+    }
 
-        map<string, unsigned int> resourceMap =
-            machineResourceConfig::getResourceTable();
+    void VWriter::emitFunction(functionJob* job) {
+        Function &F = *job->F;
+        listSchedulerVector &lv = job->lv;
+        verilogLanguage verilogPrinter(F.getParent(),Mang,&job->TD,m_config);
+        designScorer ds(job->loopBlocks, m_config);
+        phaseTimer scoreTimer("emit/score");
 
-        unsigned int include_size = resourceMap["include_size"];
-        unsigned int include_freq = resourceMap["include_freq"];
-        unsigned int include_clocks = resourceMap["include_clocks"];
-        float MDF = (float)resourceMap["delay_memport"];
+        for (listSchedulerVector::iterator it=lv.begin(); it!=lv.end(); ++it) {
+            ds.addListScheduler(*it);
+        }
+
+        unsigned int include_size = m_config.include_size;
+        unsigned int include_freq = m_config.include_freq;
+        unsigned int include_clocks = m_config.include_clocks;
+        float MDF = (float)m_config.delay_memport;
 
         float freq = ds.getDesignFrequency();
         float clocks = ds.getDesignClocks();
         float gsize = ds.getDesignSizeInGates(&F);
+        unsigned int heuristicClocks = ds.getDesignClocks(true);
+        scoreTimer.stop();
 
         if (0==include_freq) freq = 1;
         if (0==include_clocks) clocks = 1;
         if (0==include_size) gsize = 1;
 
-        std::cerr<<"\n\n---  Synthesis Report ----\n";
-        std::cerr<<"Estimated circuit delay   : " << freq<<"ns ("<<1000/freq<<"Mhz)\n";
-        std::cerr<<"Estimated circuit size    : " << gsize<<"\n";
-        std::cerr<<"Calculated loop throughput: " << clocks<<"\n";
-        std::cerr<<"--------------------------\n";
+        stringstream report;
+        report<<"\n\n---  Synthesis Report ----\n";
+        report<<"Estimated circuit delay   : " << freq<<"ns ("<<1000/freq<<"Mhz)\n";
+        report<<"Estimated circuit size    : " << gsize<<"\n";
+        report<<"Calculated loop throughput: " << clocks<<"\n";
+        report<<"Heuristic loop throughput : " << heuristicClocks<<"\n";
+        report<<"Scheduler arena           : " << job->arena.getBytesAllocated()<<" bytes in "
+            <<job->arena.getNumObjects()<<" objects\n";
+        report<<"--------------------------\n";
+        job->report = report.str();
+
+        stringstream ss;
+        ss<<getFileHeader();
+        ss<<"/* Total Score= |"<< ((clocks*sqrt(clocks))*(freq)*(gsize))/(MDF) <<"| */"; 
+        ss<<"/* freq="<<freq<<" clocks="<<clocks<<" size="<<gsize<<"*/\n"; 
+        ss<<"/* Clocks to finish= |"<< clocks <<"| */\n"; 
+        ss<<"/* Design Freq= |"<< freq <<"| */\n"; 
+        ss<<"/* Gates Count = |"<< gsize <<"| */\n"; 
+        ss<<"/* Loop BB Percent = |"<< ds.getLoopBlocksCount() <<"| */\n"; 
+
+        {
+            phaseTimer timer("emit/signature");
+            ss<<verilogPrinter.getFunctionSignature(&F,std::string(""));
+        }
+        {
+            phaseTimer timer("emit/memories");
+            ss<<verilogPrinter.getMemDecl(&F);
+        }
+        {
+            phaseTimer timer("emit/variables");
+            ss<<verilogPrinter.getFunctionLocalVariables(lv);
+        }
+        {
+            phaseTimer timer("emit/states");
+            ss<<verilogPrinter.getStateDefs(lv);
+        }
+        {
+            phaseTimer timer("emit/assignments");
+            ss<<verilogPrinter.getAssignmentString(lv);
+        }
 
-        Out<<"/* Total Score= |"<< ((clocks*sqrt(clocks))*(freq)*(gsize))/(MDF) <<"| */"; 
-        Out<<"/* freq="<<freq<<" clocks="<<clocks<<" size="<<gsize<<"*/\n"; 
-        Out<<"/* Clocks to finish= |"<< clocks <<"| */\n"; 
-        Out<<"/* Design Freq= |"<< freq <<"| */\n"; 
-        Out<<"/* Gates Count = |"<< gsize <<"| */\n"; 
-        Out<<"/* Loop BB Percent = |"<< ds.getLoopBlocksCount() <<"| */\n"; 
+        ss<<verilogPrinter.getClockHeader(lv);
+        ss<<"\n// Datapath \n";
+        {
+            phaseTimer timer("emit/datapath");
+            for (listSchedulerVector::iterator it=lv.begin(); it!=lv.end(); ++it) {
+                ss<<verilogPrinter.printBasicBlockDatapath(*it);
+            }
+        }
 
-        Out<<verilogPrinter.getFunctionSignature(&F,std::string(""));
-        Out<<verilogPrinter.getMemDecl(&F);
-        Out<<verilogPrinter.getFunctionLocalVariables(lv);
-        Out<<verilogPrinter.getStateDefs(lv);
+        ss<<"\n\n// Control \n";
+        ss<<verilogPrinter.getCaseHeader();
+        {
+            phaseTimer timer("emit/control");
+            for (listSchedulerVector::iterator it=lv.begin(); it!=lv.end(); ++it) {
+                ss<<verilogPrinter.printBasicBlockControl(*it);
+            }
+        }
 
-        Out<<verilogPrinter.getAssignmentString(lv);
+        ss<<verilogPrinter.getCaseFooter();
+        ss<<verilogPrinter.getClockFooter();
+        ss<<verilogPrinter.getModuleFooter();
+        {
+            phaseTimer timer("emit/testbench");
+            ss<<verilogPrinter.getTestBench(F);
+        }
+        //std::cerr<<"done scheduling function\n";
+        job->verilog = ss.str();
 
-        Out<<verilogPrinter.getClockHeader();
-        Out<<"\n// Datapath \n";
-        for (listSchedulerVector::iterator it=lv.begin(); it!=lv.end(); ++it) {
-            Out<<verilogPrinter.printBasicBlockDatapath(*it);
+        // Release the schedules of this function. 
+        lv.clear();
+        job->arena.reset();
+    }
+
+    string VWriter::getLibraryComponents() {
+        verilogLanguage verilogPrinter(NULL,Mang,TD,m_config);
+        stringstream ss;
+        ss<<"\n\n// -- Library components --  \n";
+        ss<<verilogPrinter.createBinOpModule("mul","*",m_config.delay_mul);
+        ss<<verilogPrinter.createBinOpModule("div","/",m_config.delay_div);
+        ss<<verilogPrinter.createBinOpModule("shl","<<",m_config.delay_shl);
+        ss<<verilogPrinter.getBRAMDefinition(m_config.mem_wordsize,m_config.membus_size);
+        return ss.str();
+    }
+
+    void VWriter::writeModuleFile(const string& name, const string& text) {
+        string path = ModuleDir + "/" + name;
+        std::string error;
+        raw_fd_ostream file(path.c_str(), error);
+        if (!error.empty()) {
+            std::cerr<<"Unable to write "<<path<<": "<<error<<"\n";
+            abort();
         }
+        file<<text;
+        NumBytesWritten += text.size();
+        // the main output includes all of the files
+        Out<<"`include \""<<path<<"\"\n";
+    }
 
-        Out<<"\n\n// Control \n";
-        Out<<verilogPrinter.getCaseHeader();
-        for (listSchedulerVector::iterator it=lv.begin(); it!=lv.end(); ++it) {
-            Out<<verilogPrinter.printBasicBlockControl(*it);
-        }
-
-        Out<<verilogPrinter.getCaseFooter();
-        Out<<verilogPrinter.getClockFooter();
-        Out<<verilogPrinter.getModuleFooter();
-        Out<<"\n\n// -- Library components --  \n";
-        Out<<verilogPrinter.createBinOpModule("mul","*",resourceMap["delay_mul"]);
-        Out<<verilogPrinter.createBinOpModule("div","/",resourceMap["delay_div"]);
-        Out<<verilogPrinter.createBinOpModule("shl","<<",resourceMap["delay_shl"]);
-        Out<<verilogPrinter.getBRAMDefinition(resourceMap["mem_wordsize"],resourceMap["membus_size"]);
-        Out<<verilogPrinter.getTestBench(F);
-        //std::cerr<<"done scheduling function\n";
-        
+    bool VWriter::runOnModule(Module &M) { 
+        phaseTimer backendTimer("backend");
+        initialize(M);
+
+        vector<Function*> functions = getSelectedFunctions(M);
+
+        // Pick the configuration before anything is lowered
+        if (DSE) exploreDesignSpace(functions);
+
+        // Functions are compiled in groups of one function per thread. The
+        // schedules of a group are released before the next group starts, 
+        // so the memory is bounded by the largest functions of the module. 
+        unsigned int group = std::max(1U, (unsigned int)SchedThreads);
+        workQueue queue(SchedThreads);
+
+        scheduleCache* cache = NULL;
+        if (!SchedCacheDir.empty()) cache = new scheduleCache(SchedCacheDir);
+        unsigned int cacheHits = 0, cacheMisses = 0;
+
+        for (unsigned int first = 0; first < functions.size(); first += group) {
+            functionJobVector jobs;
+            listSchedulerVector blocks;
+            vector<string> keys;
+            vector<schedulingEngine*> engines;
+            for (unsigned int i = first; i < functions.size() && i < first + group; ++i) {
+                functionJob* job = new functionJob(functions[i]);
+                phaseTimer timer("lower");
+                lowerFunction(job);
+                blocks.insert(blocks.end(), job->lv.begin(), job->lv.end());
+                keys.insert(keys.end(), job->cacheKeys.begin(), job->cacheKeys.end());
+                engines.insert(engines.end(), job->engines.begin(), job->engines.end());
+                jobs.push_back(job);
+            }
+
+            // The blocks are independent now, schedule them on all threads
+            vector<char> hits(blocks.size(), 0);
+            scheduleContext sctx;
+            sctx.blocks = &blocks;
+            sctx.engines = &engines;
+            sctx.keys = &keys;
+            sctx.cache = cache;
+            sctx.hits = &hits;
+            sctx.pipeline = ModuloSched;
+            {
+                phaseTimer timer("schedule");
+                queue.run(blocks.size(), scheduleBlockJob, &sctx);
+            }
+            if (cache) {
+                unsigned int groupHits = std::count(hits.begin(), hits.end(), 1);
+                cacheHits += groupHits;
+                cacheMisses += blocks.size() - groupHits;
+            }
+
+            // Trace the blocks in block order so the trace does not depend 
+            // on the number of threads
+            if (m_trace) {
+                for (listSchedulerVector::iterator it=blocks.begin(); it!=blocks.end(); ++it) {
+                    m_trace->addBlock(*it);
+                }
+            }
+
+            emitContext ctx;
+            ctx.writer = this;
+            ctx.jobs = &jobs;
+            {
+                phaseTimer timer("emit");
+                queue.run(jobs.size(), emitFunctionJob, &ctx);
+            }
+
+            for (functionJobVector::iterator it=jobs.begin(); it!=jobs.end(); ++it) {
+                std::cerr<<(*it)->report;
+                if (ModuleDir.empty()) {
+                    Out<<(*it)->verilog;
+                    NumBytesWritten += (*it)->verilog.size();
+                } else {
+                    writeModuleFile(toPrintable((*it)->F->getName()) + ".v", (*it)->verilog);
+                }
+                delete *it;
+            }
+
+            // Release the instructions which were only referenced by the schedules
+            globalVarRegistry gvr;
+            gvr.releaseGarbage();
+        }
+
+        // The library is shared by all of the modules
+        if (ModuleDir.empty()) {
+            string library = getLibraryComponents();
+            Out<<library;
+            NumBytesWritten += library.size();
+        } else {
+            writeModuleFile("vcc_lib.v", getFileHeader() + getLibraryComponents());
+        }
+
+        if (cache) {
+            std::cerr<<"Schedule cache: "<<cacheHits<<" hits, "<<cacheMisses<<" misses\n";
+            delete cache;
+        }
+
+        if (m_trace) m_trace->write();
+
+        backendTimer.stop();
+        backendStats::printReport();
+        finalize();
         return true;
     }
 
-    bool VWriter::doFinalization(Module &M) {
-      //globalVarRegistry gvr;
-      //gvr.destroy();
+    void VWriter::finalize() {
+        globalVarRegistry gvr;
+        gvr.destroy();
+        delete m_exactEngine;
+        delete m_engine;
+        delete m_trace;
         delete Mang;
         //delete tCtx;
         delete tAI;
         delete TD;
-        return true;
     }
 
-    bool VWriter::doInitialization(Module &M) {
+    void VWriter::initialize(Module &M) {
+      m_config = machineResourceConfig::getResourceConfig();
+      designScorer::fitPipelineDepths(m_config);
+      m_engine = schedulingEngine::create(Scheduler);
+      m_exactEngine = NULL;
+      if (ExactSched) m_exactEngine = new exactSchedulingEngine(*m_engine, ExactMaxOps, ExactBudget);
+      m_trace = scheduleTrace::isEnabled() ? new scheduleTrace() : NULL;
       TD = new TargetData(&M);
       tAI = new VBEMCAsmInfo();
       tCtx = new MCContext(*tAI, NULL);
@@ -227,7 +820,6 @@ class VBEMCAsmInfo : public MCAsmInfo {
       //Mang->markCharUnacceptable('.'); //TODO
         globalVarRegistry gvr;
         gvr.init(&M);
-        return true;
     }
 
 } // namespace
@@ -1,5 +1,7 @@
 /* Nadav Rotem  - C-to-Verilog.com */
 #include "abstractHWOpcode.h"
+#include "designScorer.h"
+#include "backendStats.h"
 
 /// assign part entry impl
 
@@ -23,7 +25,8 @@ namespace xVerilog{
 
     /// abstractHWOpcode impl
 
-    void abstractHWOpcode::addBinaryInstruction(Instruction *inst, string op, unsigned int delay) {
+    void abstractHWOpcode::addBinaryInstruction(Instruction *inst, string op, const resourceClass& rc) {
+        unsigned int delay = rc.latency;
 
         globalVarRegistry gvr;  
         // TODO: if operands of this bin command are not 32bit then we need
@@ -34,7 +37,7 @@ namespace xVerilog{
         GlobalValue* BinO = gvr.getGlobalVariableByName(string("out_")+op,32);
 
         // create the assign part multiplexer for the the binary unit
-        m_assignPart = new assignPartEntry(inst->getOperand(0), inst->getOperand(1));
+        m_assignPart = m_arena->create<assignPartEntry>(inst->getOperand(0), inst->getOperand(1));
 
         // load instruction from the value of the assign part
         LoadInst* ld = new LoadInst(BinO);
@@ -71,6 +74,9 @@ namespace xVerilog{
         this->appendInstructionCycle(nop, 0);
         this->appendInstructionCycle(cycleN, 1);
 
+        // a unit which is not pipelined takes no new operands for its II
+        if (rc.ii > 1) holdStream(rc.getBusyStream(), rc.ii);
+
         // Append all unused instruction for dependecy calculation
         // This will be used when calculating the next available slots
         // for the next command.
@@ -107,19 +113,21 @@ static string getVarName(Value* Op){
 	}
         return "VAR";	
 }
-    abstractHWOpcode::abstractHWOpcode(Instruction* inst, string stateName, unsigned int streamNum,TargetData* TD): 
-        TD(TD),m_empty(false),m_place(0),m_stateName(stateName),m_iv(streamNum),m_mustBeLast(false) {
-            // get the configuration of the units from the command line
-            map<string, unsigned int> resourceMap = machineResourceConfig::getResourceTable();
-
+    abstractHWOpcode::abstractHWOpcode(Instruction* inst, string stateName, schedulingArena* arena,
+            const resourceConfig& config, TargetData* TD): 
+        TD(TD),m_empty(false),m_place(0),m_stateName(stateName),
+        // the unit is not known yet, but all of the classes have the same phases
+        m_iv(config.getResourceClass("other").phases),m_mustBeLast(false),
+        m_arena(arena),m_ii(0) {
             // Init global registry with this module
             globalVarRegistry gvr;  
             gvr.init(inst->getParent()->getParent()->getParent());
 
             // this may not be used
             m_assignPart = NULL;
+            ++NumOpcodes;
 
-            if (abstractHWOpcode::isInstructionOnlyWires(inst)) {
+            if (abstractHWOpcode::isInstructionOnlyWires(inst, config, &arena->getWireDelays())) {
                 m_opcodeName = "other";
                 //empty instruction;
                 InstructionCycle cycle;
@@ -170,7 +178,7 @@ static string getVarName(Value* Op){
                 this->appendInstructionCycle(cycle0, 0);
 
                 // add memport delay
-                for (unsigned int i=0; i<(resourceMap["delay_memport"]-1); i++) {
+                for (unsigned int i=0; i<(config.delay_memport-1); i++) {
                     this->appendInstructionCycle(nop, 1);
                     this->appendInstructionCycle(cycle0, 0);
                 }
@@ -178,40 +186,50 @@ static string getVarName(Value* Op){
                 this->appendInstructionCycle(nop, 0);
                 this->appendInstructionCycle(cycle1, 1);
                 return;
-            } else if (StoreInst *st = dyn_cast<StoreInst>(inst)) {
-                ArrayInfo inf = getVariableNameFromMemoryCommand(st); //JAWAD
+            } else if (isa<StoreInst>(inst) || isPredicatedStore(inst)) {
+                ArrayInfo inf = getVariableNameFromMemoryCommand(inst); //JAWAD
                 std::string arrName = inf.first; 
                 m_opcodeName = "mem_" + arrName;
+                // the value and the address, the arguments of a predicated store
+                Value* data = inst->getOperand(0);
+                Value* addr = inst->getOperand(1);
+                if (isPredicatedStore(inst)) {
+                    data = getPredicatedStoreArgument(inst, PredicatedStoreValue);
+                    addr = getPredicatedStoreArgument(inst, PredicatedStorePointer);
+                }
                 // store the data
 
-    		const Type* typ0 =  inst->getOperand(0)->getType(); //JAWAD
+    		const Type* typ0 =  data->getType(); //JAWAD
 		GlobalVariable*  v1;
                 	v1 = gvr.getGlobalVariableByName("mem_"+arrName+"_in", typ0);
 		StoreInst* s1;
 		//check if there is IntToPtrInst ...
-		if (IntToPtrInst* i2p = dyn_cast<IntToPtrInst>(inst->getOperand(0))) {
+		if (IntToPtrInst* i2p = dyn_cast<IntToPtrInst>(data)) {
                 	s1 = new StoreInst(i2p->getOperand(0),v1); 
 
 		}else{
-                	s1 = new StoreInst(inst->getOperand(0),v1); 
+                	s1 = new StoreInst(data,v1); 
 		}
-                // store the data write mode 
-                StoreInst* s2 = new StoreInst(ConstantInt::get(Type::getInt1Ty(inst->getContext()), 1), 
+                // store the data write mode. A predicated store only writes
+                // if its predicate is set.
+                Value* mode = ConstantInt::get(Type::getInt1Ty(inst->getContext()), 1);
+                if (isPredicatedStore(inst)) mode = getPredicatedStoreArgument(inst, PredicatedStorePredicate);
+                StoreInst* s2 = new StoreInst(mode, 
                         gvr.getGlobalVariableByName("mem_"+arrName+"_mode",1));
                 // store address
 		GlobalVariable*  v2;
 
-		getVarName( inst->getOperand(1));
+		getVarName(addr);
       
-                const Type* addr_type = inst->getOperand(1)->getType();
+                const Type* addr_type = addr->getType();
 		v2 = gvr.getGlobalVariableByName("mem_"+arrName+"_addr", addr_type);	
 		StoreInst* s3 ;
                 
-		if (BitCastInst *BCI = dyn_cast<BitCastInst>((inst->getOperand(1)))){
+		if (BitCastInst *BCI = dyn_cast<BitCastInst>(addr)){
                 	s3 = new StoreInst(BCI->getOperand(0),v2); 
         	}else{ 
    
-                	s3 = new StoreInst(inst->getOperand(1),v2); 
+                	s3 = new StoreInst(addr,v2); 
 		}
                 // store the data write mode 
                 StoreInst* s4 = new StoreInst(ConstantInt::get(Type::getInt1Ty(inst->getContext()), 0), 
@@ -235,7 +253,7 @@ static string getVarName(Value* Op){
                 this->appendInstructionCycle(cycle0, 0);
                 this->appendInstructionCycle(nop, 1);
                 // add memport delay
-                for (unsigned int i=0; i<(resourceMap["delay_memport"]-1); i++) {
+                for (unsigned int i=0; i<(config.delay_memport-1); i++) {
                     this->appendInstructionCycle(cycle0, 1);
                     this->appendInstructionCycle(nop, 0);
                 }
@@ -249,18 +267,18 @@ static string getVarName(Value* Op){
                 // similar to the 'load' instruction. 
 
                 if ((bin->getOpcode()) == Instruction::Mul) {
-                    addBinaryInstruction(bin, "mul", resourceMap["delay_mul"]);
+                    addBinaryInstruction(bin, "mul", config.getResourceClass("mul"));
                     return;
                 }
                 if ((bin->getOpcode()) == Instruction::SDiv) {
-                    addBinaryInstruction(bin, "div", resourceMap["delay_div"]);
+                    addBinaryInstruction(bin, "div", config.getResourceClass("div"));
                     return;
                 }
                 if ((bin->getOpcode()) == Instruction::Shl) {
                     // do not create an assign part if this shift
                     // is by a constant  example: (a<<2)
                     if (!dyn_cast<Constant>(bin->getOperand(1))) {
-                        addBinaryInstruction(bin, "shl", resourceMap["delay_shl"]);
+                        addBinaryInstruction(bin, "shl", config.getResourceClass("shl"));
                         return;
                     }
                 }
@@ -286,8 +304,24 @@ static string getVarName(Value* Op){
       }
 
 
+    void abstractHWOpcode::holdStream(unsigned int streamID, unsigned int cycles) {
+        if (m_iv.size() <= streamID) m_iv.resize(streamID+1);
+        if (m_hold.size() <= streamID) m_hold.resize(streamID+1, 0);
+        m_hold[streamID] = std::max(m_hold[streamID], cycles);
+        // the stream is as long as the cycles it holds
+        if (m_iv[streamID].size() < cycles) m_iv[streamID].resize(cycles);
+    }
+
     void abstractHWOpcode::addDependency(abstractHWOpcode* dep) {
         m_dependencies.insert(dep);
+        m_lastCycleDependencies.erase(dep);
+    }
+
+    void abstractHWOpcode::addDependencyOnLastCycle(abstractHWOpcode* dep) {
+        // a real dependency on the result wins
+        if (isDepends(dep)) return;
+        m_dependencies.insert(dep);
+        m_lastCycleDependencies.insert(dep);
     }
 
     bool abstractHWOpcode::isDepends(abstractHWOpcode* dep) {
@@ -307,7 +341,9 @@ static string getVarName(Value* Op){
         unsigned int slot = 0;
         for (set<abstractHWOpcode*>::iterator I = m_dependencies.begin();
                 I != m_dependencies.end(); ++I) {
-            slot = std::max((*I)->getFirstAfter() ,slot) ;
+            unsigned int after = (*I)->getFirstAfter();
+            if ((*I)->getLength() && m_lastCycleDependencies.count(*I)) after--;
+            slot = std::max(after ,slot) ;
         }
         return slot;
     }  
@@ -355,80 +391,90 @@ static string getVarName(Value* Op){
         return sb.str();
     }
 
-    void abstractHWOpcode::addDependencyIfDepends(abstractHWOpcode *hwop) {
-        for (unsigned i=0; i<m_iv.size(); i++) {
-            addDependencyIfDepends(hwop, m_iv[i]);
-        }
+    void abstractHWOpcode::addDependencyOnOwner(Instruction *inst, OpcodeOwnerMap &owners) {
+        OpcodeOwnerMap::iterator it = owners.find(inst);
+        if (it != owners.end() && it->second != this) addDependency(it->second);
     }
 
-    void abstractHWOpcode::addDependencyIfDepends(abstractHWOpcode *hwop, InstructionSequence &iv) {
-        // TODO: refactor
-        InstructionSequence::iterator cyc_it;
-        InstructionCycle::iterator inst_it; 
-        if (this==hwop) return;
-
-        // for each cycle in this opcode 
-        for (cyc_it = iv.begin(); cyc_it!=iv.end(); ++cyc_it) {
-            // for each instruction in this cycle
-            for (inst_it = cyc_it->begin(); inst_it != cyc_it->end(); ++inst_it ) {
-                /* 
-                 * Note: 
-                 * branch instructions must come last (because of the jump). 
-                 * They do not simply depend on everything else because that
-                 *  we we may loose a cycle if the condition may be calculated
-                 *  way before the end of the BB and the branch can be merged
-                 *  with the last instruction. However, in the last instrtuction 
-                 *  we also have the coding of the PHI nodes which set some 
-                 *  values for phi variavles of loops. In here we depend only
-                 *  on opcodes which the next PHINode depends on.
-                 */
-                if (BranchInst* br = dyn_cast<BranchInst>(*inst_it)) {
-                    // This opcode must come last
-                    m_mustBeLast = true;
-            
-                    // We will check to see if our target BB PHINodes are dependent
-                    // on this instruction. If we are dependent on them then we need 
-                    // to be at least one cycle after them.
-                    std::vector<Instruction*> v = getAllIncomingValuesFromBranch(br);
-                    if (hwop->hasInstruction(v)) { 
-                        addDependency(hwop);
-                    }
-
-                    // Now, we will continue and check if the condition depends 
-                    // on any other opcodes.
-                }
-
-                /*
-                 * The return instruction must come last. Also, a return is usually
-                 * not inside a loop so we do not care about loosing a cycle or two. 
-                 */
-                if (dyn_cast<ReturnInst>(*inst_it)) this->addDependency(hwop);
+    void abstractHWOpcode::addOperandDependencies(Instruction *inst, OpcodeOwnerMap &owners) {
+        // for each dependency of this instruction
+        for (User::op_iterator dep_iter = inst->op_begin();
+                dep_iter != inst->op_end(); ++dep_iter){
+            // turn dependency to instruction
+            if (Instruction *inst_dep = dyn_cast<Instruction>(*dep_iter)){
+                // if an opcode holds one of our dependencies, we depend on it
+                addDependencyOnOwner(inst_dep, owners);
+            }
+        }// each dep
+    }
 
-                // for each dependency of each instruction in our opcode
-                for (User::op_iterator dep_iter = (*inst_it)->op_begin();
-                        dep_iter != (*inst_it)->op_end(); ++dep_iter){
+    void abstractHWOpcode::addDependencies(OpcodeOwnerMap &owners, vector<abstractHWOpcode*> &previous) {
+        // for each stream in this opcode
+        for (unsigned i=0; i<m_iv.size(); i++) {
+            // for each cycle in this opcode 
+            for (InstructionSequence::iterator cyc_it = m_iv[i].begin(); cyc_it!=m_iv[i].end(); ++cyc_it) {
+                // for each instruction in this cycle
+                for (InstructionCycle::iterator inst_it = cyc_it->begin(); inst_it != cyc_it->end(); ++inst_it ) {
+                    /* 
+                     * Note: 
+                     * branch instructions must come last (because of the jump). 
+                     * They do not simply depend on everything else because that
+                     *  we we may loose a cycle if the condition may be calculated
+                     *  way before the end of the BB and the branch can be merged
+                     *  with the last instruction. However, in the last instrtuction 
+                     *  we also have the coding of the PHI nodes which set some 
+                     *  values for phi variavles of loops. In here we depend only
+                     *  on opcodes which the next PHINode depends on.
+                     */
+                    if (BranchInst* br = dyn_cast<BranchInst>(*inst_it)) {
+                        // This opcode must come last
+                        m_mustBeLast = true;
+
+                        // We will check to see if our target BB PHINodes are dependent
+                        // on this instruction. If we are dependent on them then we need 
+                        // to be at least one cycle after them.
+                        std::vector<Instruction*> v = getAllIncomingValuesFromBranch(br);
+                        for (std::vector<Instruction*>::iterator in = v.begin(); in != v.end(); ++in) {
+                            addDependencyOnOwner(*in, owners);
+                        }
+
+                        // Now, we will continue and check if the condition depends 
+                        // on any other opcodes.
+                    }
 
-                    // turn dependency to instruction
-                    if (Instruction *inst_dep = dyn_cast<Instruction>(*dep_iter)){
-                        // if op holds one of our dependencies, we depend on it
-                        if (hwop->hasInstruction(inst_dep)) this->addDependency(hwop);
+                    /*
+                     * The return instruction must come last. Also, a return is usually
+                     * not inside a loop so we do not care about loosing a cycle or two. 
+                     */
+                    if (dyn_cast<ReturnInst>(*inst_it)) {
+                        for (vector<abstractHWOpcode*>::iterator op = previous.begin(); op != previous.end(); ++op) {
+                            if (*op != this) addDependency(*op);
+                        }
                     }
-                }// each dep
-            }//each inst
-        }//each cycle
+
+                    addOperandDependencies(*inst_it, owners);
+                }//each inst
+            }//each cycle
+        }//each stream
 
         // for each one of the non participating inst    
         for (set<Instruction*>::iterator inst_it = m_usedInst.begin(); 
                 inst_it!=m_usedInst.end(); ++inst_it) {
-            // for each dependency of our passive instructions
-            for (User::op_iterator dep_iter = (*inst_it)->op_begin();
-                    dep_iter != (*inst_it)->op_end(); ++dep_iter){
-                // turn dependency to instruction
-                if (Instruction *inst_dep = dyn_cast<Instruction>(*dep_iter)){
-                    // if op holds one of our dependencies, we depend on it
-                    if (hwop->hasInstruction(inst_dep)) this->addDependency(hwop);
+            addOperandDependencies(*inst_it, owners);
+        }
+    }
+
+    void abstractHWOpcode::registerInstructions(OpcodeOwnerMap &owners) {
+        for (unsigned i=0; i<m_iv.size(); i++) {
+            for (InstructionSequence::iterator cyc_it = m_iv[i].begin(); cyc_it!=m_iv[i].end(); ++cyc_it) {
+                for (InstructionCycle::iterator inst_it = cyc_it->begin(); inst_it != cyc_it->end(); ++inst_it ) {
+                    owners[*inst_it] = this;
                 }
-            }// each dep
+            }
+        }
+        for (set<Instruction*>::iterator inst_it = m_usedInst.begin(); 
+                inst_it!=m_usedInst.end(); ++inst_it) {
+            owners[*inst_it] = this;
         }
     }
 
@@ -436,13 +482,106 @@ static string getVarName(Value* Op){
 
     void abstractHWOpcode::place(unsigned int cycle,unsigned int unitid) {
         m_place = cycle;
-        if (m_assignPart) m_assignPart->setUnit(unitid, getName(),m_stateName, cycle);
+        // in a pipelined loop the operands are selected in the kernel state
+        unsigned int state = m_ii ? cycle % m_ii : cycle;
+        if (m_assignPart) m_assignPart->setUnit(unitid, getName(),m_stateName, state);
     }
 
 
-    bool abstractHWOpcode::isInstructionOnlyWires(Instruction* inst) {
-        // User guided parameters
-        map<string, unsigned int> resourceMap = machineResourceConfig::getResourceTable();
+    /// chains of more operations than this are cut by a register
+    static const unsigned int MaxChainLength = 8;
+
+    /// @return true if inst may be chained with its operands into one cycle
+    static bool isChainable(Instruction* inst) {
+        if (dyn_cast<ICmpInst>(inst)) return true;
+        if (dyn_cast<SelectInst>(inst)) return true;
+        if (BinaryOperator* bin = dyn_cast<BinaryOperator>(inst)) {
+            switch (bin->getOpcode()) {
+                case Instruction::Add:
+                case Instruction::Sub:
+                case Instruction::And:
+                case Instruction::Or:
+                case Instruction::Xor: return true;
+                default: break;
+            }
+        }
+        return false;
+    }
+
+    /// @return true if inst is always made of wires, whatever the clock
+    static bool isWiring(Instruction* inst, const resourceConfig& config);
+
+    /*
+     * @return the delay from the registers to the output of inst if inst is a
+     *  wire, or a negative number if it is a register. 'length' is set to the
+     *  number of chained operations on the longest path. Once a path is too
+     *  long or too slow for its consumer, the rest of the operands are not
+     *  visited and the delay and length are only a lower bound, which is
+     *  enough to make every consumer a register.
+     */
+    static double getWireDelay(Instruction* inst, const resourceConfig& config, unsigned int& length,
+            WireDelayMap& delays) {
+        // The decision only depends on the operands, which the lowering of
+        // the other opcodes does not change, so a shared operand of several
+        // chains is only walked once.
+        WireDelayMap::iterator known = delays.find(inst);
+        if (known != delays.end()) {
+            length = known->second.length;
+            return known->second.delay;
+        }
+
+        length = 0;
+        bool wiring = isWiring(inst, config);
+        double arrival = -1;
+        if (wiring || isChainable(inst)) {
+            arrival = 0;
+            for (User::op_iterator op = inst->op_begin(); op != inst->op_end(); ++op) {
+                Instruction* operand = dyn_cast<Instruction>(*op);
+                if (!operand) continue;
+                unsigned int operandLength;
+                double delay = getWireDelay(operand, config, operandLength, delays);
+                // the operand is a register
+                if (delay < 0) continue;
+                arrival = std::max(arrival, delay);
+                length = std::max(length, operandLength);
+                if (length >= MaxChainLength || arrival > config.target_clock_ns) break;
+            }
+            arrival += designScorer::getDelayForInstruction(inst);
+
+            // The chain has to fit the clock together with its consumer.
+            if (!wiring) {
+                length++;
+                if (length > MaxChainLength) arrival = -1;
+                else if (arrival + designScorer::getChainSlack() > config.target_clock_ns) arrival = -1;
+            }
+        }
+
+        wireDelay entry;
+        entry.delay = arrival;
+        entry.length = length;
+        delays[inst] = entry;
+        return arrival;
+    }
+
+    bool abstractHWOpcode::isChainLink(Instruction* inst, const resourceConfig& config) {
+        return isWiring(inst, config) || isChainable(inst);
+    }
+
+    bool abstractHWOpcode::isInstructionOnlyWires(Instruction* inst, const resourceConfig& config,
+            WireDelayMap* delays) {
+        if (isWiring(inst, config)) return true;
+
+        // chain simple operations into the cycle of their operands
+        if (config.target_clock_ns > 0 && isChainable(inst)) {
+            unsigned int length;
+            if (delays) return (getWireDelay(inst, config, length, *delays) >= 0);
+            WireDelayMap local;
+            return (getWireDelay(inst, config, length, local) >= 0);
+        }
+        return false;
+    }
+
+    static bool isWiring(Instruction* inst, const resourceConfig& config) {
 
         if (dyn_cast<TruncInst>(inst)) return true;
         if (dyn_cast<IntToPtrInst>(inst)) return true;
@@ -450,7 +589,8 @@ static string getVarName(Value* Op){
         if (dyn_cast<ZExtInst>(inst)) return true;
         if (dyn_cast<SExtInst>(inst)) return true;
         if (dyn_cast<TruncInst>(inst)) return true;
-        if (dyn_cast<CallInst>(inst)) return true;
+        // intrinsics are wires, predicated stores use the memory port
+        if (dyn_cast<CallInst>(inst)) return !isPredicatedStore(inst);
         if (dyn_cast<GetElementPtrInst>(inst)) return true;
 
         
@@ -475,7 +615,8 @@ static string getVarName(Value* Op){
             // which are simply a few gates (we are going to get killed by
             // the MUX any ways)
             unsigned int bitWidth = cast<IntegerType>(calc->getType())->getBitWidth();
-            if (bitWidth <= resourceMap["inline_op_to_wire"]) {
+            // User guided parameters
+            if (bitWidth <= config.inline_op_to_wire) {
                 //cerr<<"Treating register as wire: "<<*calc;
                 return true;
             }
@@ -561,6 +702,8 @@ static string getVarName(Value* Op){
         // or it can be via a GetElementPtrInst.
         if (StoreInst *st = dyn_cast<StoreInst>(inst)) {
             param = st->getOperand(1); // Store X to 'param'
+        } else if (isPredicatedStore(inst)) {
+            param = getPredicatedStoreArgument(inst, PredicatedStorePointer); // Store X to 'param' if 'pred'
         } else if (LoadInst *ld = dyn_cast<LoadInst>(inst)) {
             param = ld->getOperand(0); // Load 'param'
         }
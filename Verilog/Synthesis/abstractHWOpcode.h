@@ -11,6 +11,7 @@
 #include "llvm/Module.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/DerivedTypes.h"
 #include "llvm/Target/TargetData.h" //JAWAD
@@ -24,6 +25,7 @@
 
 #include "../params.h"
 #include "globalVarsRegistry.h"
+#include "schedulingArena.h"
 using namespace llvm;
 
 using std::set;
@@ -79,6 +81,15 @@ namespace xVerilog {
     }; // class
 
     typedef std::pair<std::string,unsigned int> ArrayInfo;
+
+    class abstractHWOpcode;
+    /*
+     * Maps each LLVM instruction of a BasicBlock to the abstractHWOpcode
+     *  which holds it. Used for finding the dependencies between opcodes
+     *  without searching the opcodes one by one.
+     */
+    typedef DenseMap<Instruction*, abstractHWOpcode*> OpcodeOwnerMap;
+
     /*
      * Represents an original LLVM instruction which is broken down into 
      *  multiple hardware instructions.
@@ -90,15 +101,18 @@ namespace xVerilog {
              * @param inst is the LLVM instruction to be represented in the abstract opcode
              *  this may modify the bitcode structure. It may add/remove and change the 
              *  dependencies of instructions. 
-             *  @param streamNum the number of streams in this opcode.
-             *  There are n streams. 
+             *  @param arena the arena which owns the objects created by this opcode
+             *  @param config the configuration of the execution units
+             *  The opcode has a stream for each phase of its resource class
+             *  (see resourceClass). 
              *  We define multiple streams so that we can have instructions which use two pipelined 
              *  dependencies such as this one.
              *   --> time 
              *  resource 1a: ..AB...
              *  resource 1b: ...AB..
              */
-            abstractHWOpcode(Instruction* inst, std::string stateName, unsigned int streamNum = 2,TargetData* TD = NULL); //JAWAD
+            abstractHWOpcode(Instruction* inst, std::string stateName, schedulingArena* arena,
+                    const resourceConfig& config, TargetData* TD = NULL); //JAWAD
             /*
              * A builder function used to define a hardware opcode using LLVM opcodes.
              *  Adds a cycle of instructions to the opcode. The cycle may be empty from any ops. 
@@ -129,8 +143,18 @@ namespace xVerilog {
              * @return are there any uOp instructions on a stream in a cycle
              */
             bool emptyAt(unsigned int streamID, unsigned int cycle) {
+                if (streamID < m_hold.size() && cycle < m_hold[streamID]) return false;
                 return (0 == cycleAt(streamID, cycle).size());
             }
+            /*
+             * Take the first 'cycles' cycles of a stream without any uOps,
+             *  to keep a unit which is not pipelined busy.
+             */
+            void holdStream(unsigned int streamID, unsigned int cycles);
+            /*
+             * @return the number of streams of this opcode
+             */
+            unsigned int getNumberOfStreams() {return m_iv.size();}
             /*
              * returns the number of cycles that this instruction take. The
              * length of the longest stream.
@@ -148,10 +172,22 @@ namespace xVerilog {
              * Declare that this opcode depends on the result of another opcode
              */
             void addDependency(abstractHWOpcode* dep);
+            /*
+             * Declare that this opcode may start in the last cycle of the opcode
+             *  'dep', but not before. A side exit of a superblock shares the
+             *  last cycle of the opcodes of its block, like the branch at the
+             *  end of a block does. Engines which only read getDependencies
+             *  see this as a normal dependency, which is safe.
+             */
+            void addDependencyOnLastCycle(abstractHWOpcode* dep);
             /*
              * True if this opcode depend on the opcode 'dep'.
              */
             bool isDepends(abstractHWOpcode* dep);
+            /*
+             * @return the opcodes which this opcode depends on
+             */
+            const set<abstractHWOpcode*>& getDependencies() {return m_dependencies;}
             /*
              * @returns the index of the cycle which is good to schedule.
              *  scans all of the dependencies and tells the first instruction which does
@@ -178,10 +214,18 @@ namespace xVerilog {
              */
             string toString();
             /*
-             * Add a dependency of this opcode on 'hwop' if it has an opcode
-             *  which is a dependency of our instructions.
+             * Add a dependency of this opcode on every opcode in 'owners' which
+             *  holds one of the operands of our instructions. 'previous' holds
+             *  all of the opcodes which were created before this one in the
+             *  BasicBlock (a return instruction depends on all of them).
+             *  This is a single pass over the operands of our instructions.
              */
-            void addDependencyIfDepends(abstractHWOpcode *hwop);
+            void addDependencies(OpcodeOwnerMap &owners, vector<abstractHWOpcode*> &previous);
+            /*
+             * Record this opcode as the owner of all of its instructions, including
+             *  the ones which are only used for the dependency calculation.
+             */
+            void registerInstructions(OpcodeOwnerMap &owners);
             /*
              * Sets the starting cycle of this opcode in the scheduling table. 
              * The list scheduler uses this to place the opcode in the instruction table. 
@@ -189,6 +233,12 @@ namespace xVerilog {
              *  It also records to which instance of the execution units it is scheduled
              */
             void place(unsigned int cycle,unsigned int unitid);
+            /*
+             * Declare that this opcode runs in a loop which starts an iteration
+             *  every 'ii' cycles. The assign part is then selected in state
+             *  (cycle % ii) of the kernel. Zero means not pipelined.
+             */
+            void setInitiationInterval(unsigned int ii) {m_ii = ii;}
             /*
              * returns the place where this opcode was scheduled. see place()
              */
@@ -204,17 +254,33 @@ namespace xVerilog {
             assignPartEntry* getAssignPart() {return m_assignPart;}
             /** 
              * @param inst the parameter to check
+             * @param config the configuration of the execution units
              * 
              * @return a static function to see if this operation can be implemented in
-             * hardware using wires only (example shl by a constant)
+             * hardware using wires only (example shl by a constant). With a target
+             * clock, additions, compares and selects are also chained into the
+             * cycle of their operands while the path fits the clock.
+             * @param delays the delays found by earlier calls on the same
+             * function, NULL to find them again
+             */
+            static bool isInstructionOnlyWires(Instruction* inst, const resourceConfig& config,
+                    WireDelayMap* delays = NULL);
+            /** 
+             * @return true if the delay of inst may be chained into the cycle
+             * of its users, so whether its users are wires depends on it.
              */
-            static bool isInstructionOnlyWires(Instruction* inst);
+            static bool isChainLink(Instruction* inst, const resourceConfig& config);
             /** 
              * @brief Is this opcode must come last in BasicBlock ?
              * 
              * @return True if yes
              */
             bool isMustBeLastOpcode() { return m_mustBeLast; }
+            /** 
+             * @brief The branch of this opcode leaves a superblock in the middle,
+             * so it does not have to come last. 
+             */
+            void setSideExit() { m_mustBeLast = false; }
 
             /** 
              * @brief Finds the width in bits of this element type. May be a pointer, an integer or an array.
@@ -227,17 +293,19 @@ namespace xVerilog {
 	    llvm::TargetData* TD;	 //JAWAD
         private:
             /*
-             * Add a dependency of this opcode on 'hwop' if it has an opcode
-             *  which is a dependency of our instructions.
-             *
-             *  @param iv looks for dependencies only in the stream iv
+             * Add a dependency on the owners of the operands of 'inst'
+             */
+            void addOperandDependencies(Instruction *inst, OpcodeOwnerMap &owners);
+            /*
+             * Add a dependency on the owner of 'inst' if it has one
              */
-            void addDependencyIfDepends(abstractHWOpcode *hwop, InstructionSequence &iv);
+            void addDependencyOnOwner(Instruction *inst, OpcodeOwnerMap &owners);
             /*
              * Serves the C'tor in creating a binary operation, which uses assign part,
              * such as 'mul' or 'div'. Creates the needed uOps and instructions.
+             * @param rc the latency and initiation interval of the unit
              */
-            void addBinaryInstruction(Instruction* inst, string op, unsigned int delay);
+            void addBinaryInstruction(Instruction* inst, string op, const resourceClass& rc);
             /** 
              * @brief This method returns all 'incoming' instruction from a BasicBlock
              *  we use this in order to see which values delay the branch instruction. 
@@ -284,14 +352,23 @@ namespace xVerilog {
             set<Instruction*> m_usedInst;
             /// dependencies it has on other opcodes
             set<abstractHWOpcode*> m_dependencies;
+            /// the dependencies whose last cycle this opcode may share
+            set<abstractHWOpcode*> m_lastCycleDependencies;
             /// assign part, if needed
             assignPartEntry* m_assignPart;
             /// name of BasicBlock/State this hw is scheduled at
             string m_stateName;
             /// the actual uOP instructions
             vector<InstructionSequence> m_iv;
+            /// the number of cycles at the start of each stream which are taken
+            /// even though they are empty
+            vector<unsigned int> m_hold;
             /// Is this abstractHWOpcode has to be last in BB ?
             bool m_mustBeLast;
+            /// owner of the assign part
+            schedulingArena* m_arena;
+            /// the initiation interval of the pipelined loop, zero if not pipelined
+            unsigned int m_ii;
     }; // class abstractHWOpcode
 
 
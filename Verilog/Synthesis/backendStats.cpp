@@ -0,0 +1,151 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#define DEBUG_TYPE "verilog"
+#include "backendStats.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <algorithm>
+
+using std::map;
+using std::stringstream;
+
+namespace xVerilog {
+
+    Statistic NumOpcodes = { DEBUG_TYPE, "Number of opcodes created by the lowering", 0, 0 };
+    Statistic NumDependencies = { DEBUG_TYPE, "Number of dependency edges between opcodes", 0, 0 };
+    Statistic NumPlacementProbes = { DEBUG_TYPE, "Number of units probed to place an opcode", 0, 0 };
+    Statistic NumStates = { DEBUG_TYPE, "Number of FSM states emitted", 0, 0 };
+    Statistic NumBytesWritten = { DEBUG_TYPE, "Number of bytes of verilog written", 0, 0 };
+
+    /// the counters and their names in the JSON report
+    static const struct {
+        Statistic* counter;
+        const char* key;
+    } Counters[] = {
+        { &NumOpcodes, "opcodes" },
+        { &NumDependencies, "dependencies" },
+        { &NumPlacementProbes, "placement_probes" },
+        { &NumStates, "states" },
+        { &NumBytesWritten, "bytes_written" }
+    };
+    static const unsigned int NumCounters = sizeof(Counters) / sizeof(Counters[0]);
+
+    /// the formats of the report
+    enum timingFormat {
+        NoTiming,
+        TableTiming,
+        JSONTiming
+    };
+
+    static cl::opt<timingFormat>
+    TimingFormat("vcc-timing", cl::desc("report the time of each phase of the backend and its counters"),
+            cl::values(
+                clEnumValN(TableTiming, "table", "a table like -time-passes"),
+                clEnumValN(JSONTiming, "json", "JSON, for the build dashboards"),
+                clEnumValEnd),
+            cl::init(NoTiming));
+
+    static cl::opt<std::string>
+    TimingFile("vcc-timing-file", cl::desc("write the -vcc-timing report to this file, - for stderr"),
+            cl::value_desc("file"), cl::init("-"));
+
+    /// the time of one phase
+    struct phaseRecord {
+        phaseRecord():seconds(0),calls(0) {}
+        double seconds;
+        unsigned int calls;
+    };
+
+    static sys::Mutex PhaseLock;
+    /// the phases by name, so each phase comes right before the phases it encloses
+    static map<string, phaseRecord> Phases;
+
+    bool backendStats::isTimingEnabled() {
+        return NoTiming != TimingFormat;
+    }
+
+    void backendStats::addPhaseTime(const char* phase, double seconds) {
+        MutexGuard guard(PhaseLock);
+        phaseRecord& rec = Phases[phase];
+        rec.seconds += seconds;
+        rec.calls++;
+    }
+
+    /// @return the JSON report
+    static string getJSONReport() {
+        stringstream ss;
+        ss<<"{\n  \"phases\": [";
+        for (map<string, phaseRecord>::iterator it = Phases.begin(); it != Phases.end(); ++it) {
+            ss<<(it != Phases.begin() ? ",\n" : "\n")<<"    {\"name\": \""<<it->first<<"\", \"calls\": "
+                <<it->second.calls<<", \"wall_seconds\": "<<it->second.seconds<<"}";
+        }
+        ss<<"\n  ],\n  \"counters\": {";
+        for (unsigned int i = 0; i < NumCounters; ++i) {
+            ss<<(i ? ",\n" : "\n")<<"    \""<<Counters[i].key<<"\": "<<Counters[i].counter->getValue();
+        }
+        ss<<"\n  }\n}\n";
+        return ss.str();
+    }
+
+    /// @return the report as a table, the phases are indented under the
+    /// phase which encloses them. "backend" is the whole backend.
+    static string getTableReport() {
+        // the whole backend, or the sum of the outer phases
+        double total = 0;
+        for (map<string, phaseRecord>::iterator it = Phases.begin(); it != Phases.end(); ++it) {
+            if (string::npos == it->first.find('/')) total += it->second.seconds;
+        }
+        if (Phases.count("backend")) total = Phases["backend"].seconds;
+
+        const char* line = "===-------------------------------------------------------------------------===\n";
+        stringstream ss;
+        ss<<std::fixed;
+        ss<<line<<"                      Verilog backend time report\n"<<line;
+        ss<<"  Total Execution Time: "<<std::setprecision(4)<<total<<" seconds (wall clock)\n\n";
+        ss<<"   ---Wall Time---   --Calls--  --- Name ---\n";
+        for (map<string, phaseRecord>::iterator it = Phases.begin(); it != Phases.end(); ++it) {
+            const string& name = it->first;
+            const phaseRecord& rec = it->second;
+            double percent = total > 0 ? rec.seconds * 100 / total : 0;
+            ss<<std::setw(9)<<std::setprecision(4)<<rec.seconds<<" ("<<std::setw(5)<<std::setprecision(1)
+                <<percent<<"%)"<<std::setw(11)<<rec.calls<<"    ";
+            unsigned int depth = std::count(name.begin(), name.end(), '/');
+            ss<<string(2*depth, ' ')<<name.substr(name.rfind('/') + 1)<<"\n";
+        }
+        ss<<"\n"<<line<<"                        Verilog backend counters\n"<<line;
+        for (unsigned int i = 0; i < NumCounters; ++i) {
+            ss<<std::setw(12)<<Counters[i].counter->getValue()<<" - "<<Counters[i].counter->getDesc()<<"\n";
+        }
+        ss<<"\n";
+        return ss.str();
+    }
+
+    void backendStats::printReport() {
+        if (!isTimingEnabled()) return;
+        string report;
+        {
+            MutexGuard guard(PhaseLock);
+            report = (JSONTiming == TimingFormat) ? getJSONReport() : getTableReport();
+        }
+
+        if ("-" == TimingFile) {
+            std::cerr<<report;
+            return;
+        }
+        std::string error;
+        raw_fd_ostream file(TimingFile.c_str(), error);
+        if (!error.empty()) {
+            std::cerr<<"Unable to write "<<TimingFile<<": "<<error<<"\n";
+            abort();
+        }
+        file<<report;
+    }
+
+} // namespace
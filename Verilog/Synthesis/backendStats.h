@@ -0,0 +1,77 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_BACKEND_STATS_H
+#define LLVM_BACKEND_STATS_H
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/TimeValue.h"
+
+#include <string>
+
+using namespace llvm;
+using std::string;
+
+namespace xVerilog {
+
+    /*
+     * The counters of the backend. They are LLVM statistics, so -stats
+     *  prints them as well.
+     */
+    extern Statistic NumOpcodes;
+    extern Statistic NumDependencies;
+    extern Statistic NumPlacementProbes;
+    extern Statistic NumStates;
+    extern Statistic NumBytesWritten;
+
+    /*
+     * The wall time of the phases of the backend, summed over all of the
+     *  threads. A phase is a name such as "schedule" or "emit/datapath",
+     *  where the part before the slash is the enclosing phase. Phases are
+     *  only timed if -vcc-timing was given, and the report is printed once,
+     *  when the backend is done.
+     */
+    class backendStats {
+        public:
+            /*
+             * @return true if the phases are timed
+             */
+            static bool isTimingEnabled();
+
+            /*
+             * Add 'seconds' to the time of 'phase'. Any thread may call it.
+             */
+            static void addPhaseTime(const char* phase, double seconds);
+
+            /*
+             * Print the times and the counters as a -time-passes like table
+             *  or as JSON, to the file of -vcc-timing-file.
+             */
+            static void printReport();
+    }; // class
+
+    /*
+     * Times the scope it is declared in as 'phase'
+     */
+    class phaseTimer {
+        public:
+            phaseTimer(const char* phase):m_phase(phase),m_enabled(backendStats::isTimingEnabled()) {
+                if (m_enabled) m_start = sys::TimeValue::now();
+            }
+            ~phaseTimer() { stop(); }
+
+            /*
+             * Stop the timer before the end of the scope
+             */
+            void stop() {
+                if (!m_enabled) return;
+                m_enabled = false;
+                sys::TimeValue time = sys::TimeValue::now() - m_start;
+                backendStats::addPhaseTime(m_phase, time.usec() / 1e6);
+            }
+        private:
+            const char* m_phase;
+            bool m_enabled;
+            sys::TimeValue m_start;
+    }; // class
+
+} //end of namespace
+#endif // h guard
@@ -2,22 +2,54 @@
 #include "designScorer.h"
 #include "../params.h"
 
+#include <cmath>
+
 namespace xVerilog {
 
+    //
+    // Times for Virtex4  XC4VLX25, of 32 bit operations
+    //
+    static const double BASE_ASSIGN_DELAY = 1.849;
+    static const double MUL_DELAY = 7.72;
+    static const double DIV_DELAY = 10;
+
+    /// @return the number of stages which split 'delay' into clocks of 'period'
+    static unsigned int getPipelineDepth(double delay, double period) {
+        // the first stage also holds the assign part multiplexer
+        double usable = period - BASE_ASSIGN_DELAY;
+        if (usable <= 0) usable = period;
+        return std::max(1, (int)ceil(delay / usable));
+    }
+
+    /// @return the clock a unit of 'delay' needs when it is split into 'depth' stages
+    static double getStageDelay(double delay, unsigned int depth) {
+        return delay / std::max(1U, depth) + BASE_ASSIGN_DELAY;
+    }
 
     double designScorer::getDesignFrequency() {
 
-        map<string, unsigned int> resourceMap = 
-            machineResourceConfig::getResourceTable();
-
-        unsigned int mul_pipes = resourceMap["delay_mul"];
-        unsigned int shl_pipes = resourceMap["delay_shl"];
-        unsigned int div_pipes = resourceMap["delay_div"];
+        unsigned int mul_pipes = m_config.delay_mul;
+        unsigned int shl_pipes = m_config.delay_shl;
+        unsigned int div_pipes = m_config.delay_div;
 
 
         unsigned int min_stages = 
             std::min(mul_pipes, std::min(shl_pipes,div_pipes));
 
+        // The chains were fitted to the target clock, and so were the units
+        // unless their depths were given or swept too shallow for it. Then
+        // the slowest stage sets the clock.
+        double period = m_config.target_clock_ns;
+        if (period > 0) {
+            if (mul_pipes >= getPipelineDepth(MUL_DELAY, period) &&
+                    div_pipes >= getPipelineDepth(DIV_DELAY, period) &&
+                    shl_pipes >= getPipelineDepth(BASE_ASSIGN_DELAY, period)) return period;
+            double stage = std::max(getStageDelay(MUL_DELAY, mul_pipes),
+                    std::max(getStageDelay(DIV_DELAY, div_pipes),
+                        getStageDelay(BASE_ASSIGN_DELAY, shl_pipes)));
+            return std::max(period, stage);
+        }
+
         double max_time = 3.5;
 
             if (0 == min_stages)  max_time = 100.0;
@@ -38,16 +70,16 @@ namespace xVerilog {
         return max_time;
     }
 
-    unsigned int designScorer::getDesignClocks() {
+    unsigned int designScorer::getDesignClocks(bool heuristic) {
         unsigned int max_loop_clocks = 0;
         unsigned int max_clocks = 0;
         for (listSchedulerVector::iterator it = m_basicBlocks.begin(); 
                 it != m_basicBlocks.end(); ++it) {
             // Is this BasicBlock a part of a loop ?
-            if (m_loopInfo->getLoopFor((*it)->getBB())) {
-                max_loop_clocks = std::max(max_loop_clocks, getBasicBlockClocks(*it));
+            if (m_loopBlocks.count((*it)->getBB())) {
+                max_loop_clocks = std::max(max_loop_clocks, getBasicBlockClocks(*it, heuristic));
             }
-                max_clocks = std::max(max_clocks, getBasicBlockClocks(*it));
+                max_clocks = std::max(max_clocks, getBasicBlockClocks(*it, heuristic));
         }
         if (max_loop_clocks != 0) return max_loop_clocks;
         return max_clocks;
@@ -61,7 +93,7 @@ namespace xVerilog {
         for (listSchedulerVector::iterator it = m_basicBlocks.begin(); it != m_basicBlocks.end(); ++it) {
             bbs+=(*it)->length();
             // Is this BasicBlock a part of a loop ?
-            if (m_loopInfo->getLoopFor((*it)->getBB())) {
+            if (m_loopBlocks.count((*it)->getBB())) {
                 lbbs+=(*it)->length();
             }
         }
@@ -73,12 +105,12 @@ namespace xVerilog {
 
     double designScorer::getBasicBlockMaxDelay(listScheduler* ls) {
         double max_delay = 0;
+        const scheduleView& view = ls->getScheduleView();
         //for each cycle in this basic block
-        for (unsigned int cycle=0; cycle<ls->length();cycle++) {
-            vector<Instruction*> inst = ls->getInstructionForCycle(cycle);
+        for (unsigned int cycle=0; cycle<view.getNumberOfCycles();cycle++) {
             //for each instruction in cycle, find it's delay ...
-            for (vector<Instruction*>::iterator ii = inst.begin(); ii != inst.end(); ++ii) {
-                max_delay = std::max(max_delay, getDelayForInstruction(*ii));
+            for (scheduleView::iterator ii = view.begin(cycle); ii != view.end(cycle); ++ii) {
+                max_delay = std::max(max_delay, getDelayForInstruction(ii->inst));
             }
         }// for each cycle      
 
@@ -92,14 +124,14 @@ namespace xVerilog {
     //
     double designScorer::getDelayForInstruction(Instruction *inst) {
 
-        const double BASE_ASSIGN_DELAY = 1.849;
-
         double delay = 0;
 
         if (dyn_cast<LoadInst>(inst)) delay =  BASE_ASSIGN_DELAY;
-        if (dyn_cast<StoreInst>(inst)) delay = BASE_ASSIGN_DELAY;
+        if (dyn_cast<StoreInst>(inst) || isPredicatedStore(inst)) delay = BASE_ASSIGN_DELAY;
         if (dyn_cast<SelectInst>(inst)) delay = BASE_ASSIGN_DELAY;
         if (dyn_cast<PHINode>(inst)) delay = BASE_ASSIGN_DELAY;
+        // a compare is a subtraction
+        if (dyn_cast<CmpInst>(inst)) delay = BASE_ASSIGN_DELAY;
 
         // Converting bits from one format to another
         if (dyn_cast<BitCastInst>(inst)) delay = 0.1;
@@ -116,10 +148,10 @@ namespace xVerilog {
                 delay =  1.849;
             }
             if (bin->getOpcode() == Instruction::UDiv ) {
-                delay =  10; // can't synthesis this
+                delay =  DIV_DELAY; // can't synthesis this
             }
             if (bin->getOpcode() == Instruction::Mul ) {
-                delay =  7.72;
+                delay =  MUL_DELAY;
             }
             if (bin->getOpcode() == Instruction::And || 
                     bin->getOpcode() == Instruction::Or || 
@@ -136,7 +168,9 @@ namespace xVerilog {
             } 
         }
 
+        // the width of a compare is the width of its operands
         const Type* Ty = inst->getType();
+        if (dyn_cast<CmpInst>(inst)) Ty = inst->getOperand(0)->getType();
         // if we don't know this type, don't normalize it
         if (!Ty->isPrimitiveType() || !Ty->isIntegerTy() || !Ty->isSized()) return delay;
         if (Ty->getTypeID() ==  Type::IntegerTyID) {
@@ -147,16 +181,26 @@ namespace xVerilog {
         return delay;
     }
 
+    double designScorer::getChainSlack() {
+        // and, or, xor
+        return BASE_ASSIGN_DELAY * 1.3;
+    }
+
+    void designScorer::fitPipelineDepths(resourceConfig& config) {
+        double period = config.target_clock_ns;
+        if (period <= 0) return;
+        if (0 == config.delay_mul) config.delay_mul = getPipelineDepth(MUL_DELAY, period);
+        if (0 == config.delay_div) config.delay_div = getPipelineDepth(DIV_DELAY, period);
+        if (0 == config.delay_shl) config.delay_shl = getPipelineDepth(BASE_ASSIGN_DELAY, period);
+    }
+
     unsigned int designScorer::getDesignSizeInGates(Function* F) {
 
         unsigned int totalGateSize = 0;
 
-        map<string, unsigned int> resourceMap = 
-            machineResourceConfig::getResourceTable();
-
-        unsigned int mul_count = resourceMap["mul"];
-        unsigned int div_count = resourceMap["div"];
-        unsigned int shl_count = resourceMap["shl"];
+        unsigned int mul_count = m_config.units_mul;
+        unsigned int div_count = m_config.units_div;
+        unsigned int shl_count = m_config.units_shl;
 
         totalGateSize += mul_count*1088 + div_count*1500 + shl_count*1000;
 
@@ -29,6 +29,8 @@ using namespace llvm;
 
 namespace xVerilog {
 
+    typedef set<const BasicBlock*> BasicBlockSet;
+
     /*
      * @brief A class for evaluating the score of a scheduling job based on the frequency
      * and number of clocks.
@@ -38,13 +40,13 @@ namespace xVerilog {
             /** 
              * @brief C'tor
              * 
-             * @param design A listScheduler object who's design
-             * we want to examine 
+             * @param loopBlocks the BasicBlocks of the function which are
+             *  inside a loop (from LoopInfo)
+             * @param config the configuration of the units from the command line
              */
-            designScorer(LoopInfo* LInfo):m_loopInfo(LInfo){
-                 // get the configuration of the units from the command line
-                map<string, unsigned int> resourceMap = machineResourceConfig::getResourceTable();
-                m_pointerSize = resourceMap["mem_wordsize"];
+            designScorer(const BasicBlockSet& loopBlocks, const resourceConfig& config):
+                m_loopBlocks(loopBlocks),m_config(config){
+                m_pointerSize = config.mem_wordsize;
             };
 
             /** 
@@ -58,9 +60,12 @@ namespace xVerilog {
 
             /** 
              * 
+             * @param heuristic use the lengths of the heuristic schedules, from
+             *  before the exact scheduler improved them
+             *
              * @return time in usec
              */
-            unsigned int getDesignClocks();
+            unsigned int getDesignClocks(bool heuristic = false);
             /** 
              * @brief Returns the max frequency that the design can stand
              * 
@@ -82,16 +87,46 @@ namespace xVerilog {
              * @return 
              */
             unsigned int getDesignSizeInGates(Function* F);
+
+            /** 
+             * @brief Returns the physical hardware execution delay time in ns
+             * 
+             * @param inst instruction to eval
+             * 
+             * @return time in ns
+             */
+            static double getDelayForInstruction(Instruction *inst);
+
+            /** 
+             * @brief The delay which the consumer of a chain of operations adds
+             *  before its register: the slowest of the simple operations.
+             * 
+             * @return time in ns
+             */
+            static double getChainSlack();
+
+            /** 
+             * @brief Pick the number of pipeline stages of each execution unit
+             *  whose delay is zero (not given), so each stage fits the target
+             *  clock period of the configuration.
+             * 
+             * @param config the configuration to update
+             */
+            static void fitPipelineDepths(resourceConfig& config);
         private:
 
             /** 
              * @brief Get the number of clocks it takes a BasicBlock to be executed (steps)
              * 
              * @param ls the listScheduler which scheduled the BB
+             * @param heuristic the length of the heuristic schedule
              * 
-             * @return clocks to complete the bb
+             * @return clocks to complete the bb, the initiation interval of a
+             *  pipelined loop
              */
-            unsigned int getBasicBlockClocks(listScheduler* ls) { return ls->length(); }
+            unsigned int getBasicBlockClocks(listScheduler* ls, bool heuristic) { 
+                return heuristic ? ls->getHeuristicLength() : ls->getStateCount(); 
+            }
 
             /** 
              * @brief Evaluate the max delay of a single BasicBlock in usec
@@ -102,15 +137,6 @@ namespace xVerilog {
              */
             double getBasicBlockMaxDelay(listScheduler* ls);
 
-            /** 
-             * @brief Returns the physical hardware execution delay time in ns
-             * 
-             * @param inst instruction to eval
-             * 
-             * @return time in ns
-             */
-            double getDelayForInstruction(Instruction *inst);
-
             /** 
              * @brief approximates the number of flip flops this instruction takes
              * 
@@ -121,7 +147,8 @@ namespace xVerilog {
             int getInstructionSize(Instruction* inst);
             /// a vector of schedulers to evaluate
             listSchedulerVector m_basicBlocks;
-            LoopInfo* m_loopInfo;
+            const BasicBlockSet& m_loopBlocks;
+            const resourceConfig& m_config;
             unsigned int m_pointerSize;
     };
 
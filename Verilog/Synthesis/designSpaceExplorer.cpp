@@ -0,0 +1,234 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "designSpaceExplorer.h"
+
+#include "llvm/Config/config.h"
+
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <cerrno>
+#include <cstdio>
+
+#if defined(LLVM_ON_UNIX)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#define VERILOG_HAVE_FORK 1
+#endif
+
+namespace xVerilog {
+
+    void designSpaceExplorer::addDimension(const string& name, unsigned int resourceConfig::*field,
+            const vector<unsigned int>& values) {
+        assert(!values.empty() && "a dimension without values");
+        dimension dim;
+        dim.name = name;
+        dim.field = field;
+        dim.values = values;
+        m_dims.push_back(dim);
+    }
+
+    void designSpaceExplorer::enumeratePoints() {
+        m_points.clear();
+        // count in a mixed radix, the first dimension changes slowest
+        vector<unsigned int> digits(m_dims.size(), 0);
+        while (true) {
+            designPoint point;
+            point.config = m_base;
+            for (unsigned int d = 0; d < m_dims.size(); ++d) {
+                point.config.*(m_dims[d].field) = m_dims[d].values[digits[d]];
+            }
+            point.valid = false;
+            point.pareto = false;
+            m_points.push_back(point);
+
+            unsigned int d = m_dims.size();
+            while (d > 0 && ++digits[d-1] == m_dims[d-1].values.size()) {
+                digits[d-1] = 0;
+                --d;
+            }
+            if (0 == d) break;
+        }
+    }
+
+#ifdef VERILOG_HAVE_FORK
+    /// Evaluate a point and send the cost to the parent. Never returns.
+    static void runChild(int fd, designSpaceExplorer::evaluateFunction fn, void* context,
+            const resourceConfig& config) {
+        // the lowering prints its progress, keep it out of the output
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) dup2(null, 1);
+
+        designCost cost = fn(config, context);
+        stringstream ss;
+        ss.precision(17);
+        ss<<cost.clocks<<" "<<cost.gates<<" "<<cost.delay<<"\n";
+        string text = ss.str();
+        if (write(fd, text.c_str(), text.size()) != (ssize_t)text.size()) _exit(1);
+        // do not run the destructors of the parent's objects
+        _exit(0);
+    }
+
+    /// @return everything the child wrote to fd
+    static string readAll(int fd) {
+        string text;
+        char buf[256];
+        while (true) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n < 0 && EINTR == errno) continue;
+            if (n <= 0) break;
+            text.append(buf, n);
+        }
+        return text;
+    }
+#endif
+
+    void designSpaceExplorer::explore(evaluateFunction fn, void* context, unsigned int workers) {
+        enumeratePoints();
+#ifdef VERILOG_HAVE_FORK
+        workers = std::max(1U, workers);
+        // the children inherit the buffers
+        std::cout.flush();
+        std::cerr.flush();
+
+        // the running children: pid -> (point, read end of the pipe)
+        map<pid_t, std::pair<unsigned int, int> > running;
+        unsigned int next = 0;
+        while (next < m_points.size() || !running.empty()) {
+            while (next < m_points.size() && running.size() < workers) {
+                int fds[2];
+                if (pipe(fds)) {
+                    std::cerr<<"Unable to create a pipe for the design space exploration\n";
+                    abort();
+                }
+                pid_t pid = fork();
+                if (pid < 0) {
+                    std::cerr<<"Unable to fork a design space exploration worker\n";
+                    abort();
+                }
+                if (0 == pid) {
+                    close(fds[0]);
+                    runChild(fds[1], fn, context, m_points[next].config);
+                }
+                close(fds[1]);
+                running[pid] = std::make_pair(next, fds[0]);
+                next++;
+            }
+
+            int status;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0) {
+                if (EINTR == errno) continue;
+                std::cerr<<"Lost the design space exploration workers\n";
+                abort();
+            }
+            map<pid_t, std::pair<unsigned int, int> >::iterator it = running.find(pid);
+            if (it == running.end()) continue;
+
+            designPoint& point = m_points[it->second.first];
+            stringstream ss(readAll(it->second.second));
+            close(it->second.second);
+            running.erase(it);
+
+            point.valid = WIFEXITED(status) && 0 == WEXITSTATUS(status) &&
+                (ss>>point.cost.clocks>>point.cost.gates>>point.cost.delay);
+            if (!point.valid) std::cerr<<"DSE: failed to evaluate "<<describe(point)<<"\n";
+        }
+#else
+        std::cerr<<"The design space exploration needs fork(), which this host does not have\n";
+        abort();
+#endif
+        markParetoFrontier();
+    }
+
+    bool designSpaceExplorer::dominates(const designCost& a, const designCost& b) {
+        if (a.clocks > b.clocks || a.gates > b.gates || a.delay > b.delay) return false;
+        return (a.clocks < b.clocks || a.gates < b.gates || a.delay < b.delay);
+    }
+
+    void designSpaceExplorer::markParetoFrontier() {
+        for (unsigned int i = 0; i < m_points.size(); ++i) {
+            m_points[i].pareto = m_points[i].valid;
+            for (unsigned int j = 0; j < m_points.size() && m_points[i].pareto; ++j) {
+                if (m_points[j].valid && dominates(m_points[j].cost, m_points[i].cost)) {
+                    m_points[i].pareto = false;
+                }
+            }
+        }
+    }
+
+    unsigned int designSpaceExplorer::getNumFailed() const {
+        unsigned int failed = 0;
+        for (unsigned int i = 0; i < m_points.size(); ++i) {
+            if (!m_points[i].valid) failed++;
+        }
+        return failed;
+    }
+
+    double designSpaceExplorer::getScore(const designCost& cost, const resourceConfig& config) {
+        double clocks = config.include_clocks ? cost.clocks : 1;
+        double freq = config.include_freq ? cost.delay : 1;
+        double gsize = config.include_size ? cost.gates : 1;
+        double MDF = std::max(1U, config.delay_memport);
+        return ((clocks*sqrt(clocks))*(freq)*(gsize))/(MDF);
+    }
+
+    const designPoint* designSpaceExplorer::getBestPoint() const {
+        const designPoint* best = NULL;
+        for (unsigned int i = 0; i < m_points.size(); ++i) {
+            const designPoint& point = m_points[i];
+            if (!point.pareto) continue;
+            // ties go to the first point, which has the fewest units
+            if (!best || getScore(point.cost, point.config) < getScore(best->cost, best->config)) {
+                best = &point;
+            }
+        }
+        return best;
+    }
+
+    string designSpaceExplorer::describe(const designPoint& point) const {
+        stringstream ss;
+        for (unsigned int d = 0; d < m_dims.size(); ++d) {
+            if (d) ss<<" ";
+            ss<<"-"<<m_dims[d].name<<"="<<point.config.*(m_dims[d].field);
+        }
+        return ss.str();
+    }
+
+    string designSpaceExplorer::getPointJSON(const designPoint& point) const {
+        stringstream ss;
+        ss<<"{";
+        for (unsigned int d = 0; d < m_dims.size(); ++d) {
+            ss<<"\""<<m_dims[d].name<<"\": "<<point.config.*(m_dims[d].field)<<", ";
+        }
+        ss<<"\"clocks\": "<<point.cost.clocks<<", ";
+        ss<<"\"gates\": "<<point.cost.gates<<", ";
+        ss<<"\"delay_ns\": "<<point.cost.delay<<", ";
+        ss<<"\"freq_mhz\": "<<(point.cost.delay > 0 ? 1000/point.cost.delay : 0)<<", ";
+        ss<<"\"score\": "<<getScore(point.cost, point.config)<<"}";
+        return ss.str();
+    }
+
+    string designSpaceExplorer::getJSON() const {
+        stringstream ss;
+        ss<<"{\n";
+        ss<<"  \"evaluated\": "<<m_points.size()<<",\n";
+        ss<<"  \"failed\": "<<getNumFailed()<<",\n";
+        const designPoint* best = getBestPoint();
+        ss<<"  \"chosen\": ";
+        if (best) ss<<getPointJSON(*best); else ss<<"null";
+        ss<<",\n";
+        ss<<"  \"frontier\": [";
+        bool first = true;
+        for (unsigned int i = 0; i < m_points.size(); ++i) {
+            if (!m_points[i].pareto) continue;
+            ss<<(first ? "\n" : ",\n")<<"    "<<getPointJSON(m_points[i]);
+            first = false;
+        }
+        ss<<"\n  ]\n";
+        ss<<"}\n";
+        return ss.str();
+    }
+
+} // namespace
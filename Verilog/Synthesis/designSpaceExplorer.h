@@ -0,0 +1,129 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_DESIGN_SPACE_EXPLORER_H
+#define LLVM_DESIGN_SPACE_EXPLORER_H
+
+#include <string>
+#include <vector>
+
+#include "../params.h"
+
+using std::string;
+using std::vector;
+
+namespace xVerilog {
+
+    /*
+     * The estimates of the designScorer for a whole design
+     */
+    struct designCost {
+        /// clocks to finish, the sum over the functions
+        double clocks;
+        /// the size in gates, the sum over the functions
+        double gates;
+        /// the circuit delay in ns, the slowest function
+        double delay;
+    };
+
+    /*
+     * One configuration of the execution units and its cost
+     */
+    struct designPoint {
+        resourceConfig config;
+        designCost cost;
+        /// false if the evaluation of the point failed
+        bool valid;
+        /// true if no other point is as good in every cost and better in one
+        bool pareto;
+    };
+
+    /*
+     * Sweeps the unit counts and pipeline depths of the resourceConfig. Every
+     *  point is lowered, scheduled and scored in a child process, which
+     *  starts from the IR as it was before the lowering. Any number of
+     *  children run at once, so the sweep does not run clang and opt again
+     *  for every point. The points which no other point beats in clocks,
+     *  gates and delay at once are the Pareto frontier. The frontier point
+     *  with the lowest design score is picked for the emission.
+     */
+    class designSpaceExplorer {
+        public:
+            /*
+             * Evaluate the design with the configuration 'config'. It runs in
+             *  a child process, so it may change the IR and global state.
+             */
+            typedef designCost (*evaluateFunction)(const resourceConfig& config, void* context);
+
+            /*
+             * C'tor
+             * @param base the configuration of the fields which are not swept
+             */
+            designSpaceExplorer(const resourceConfig& base):m_base(base) {}
+
+            /*
+             * Sweep the field 'field' of the configuration over 'values'.
+             * @param name the name of the field in the report
+             */
+            void addDimension(const string& name, unsigned int resourceConfig::*field,
+                    const vector<unsigned int>& values);
+
+            /*
+             * Evaluate every combination of the values of the dimensions by
+             *  calling fn(config, context), up to 'workers' processes at once,
+             *  and find the Pareto frontier.
+             */
+            void explore(evaluateFunction fn, void* context, unsigned int workers);
+
+            /*
+             * @return the point to emit: the frontier point with the lowest
+             *  score, or NULL if no point could be evaluated
+             */
+            const designPoint* getBestPoint() const;
+
+            /*
+             * @return the number of points which were evaluated, and the
+             *  number of those which failed
+             */
+            unsigned int getNumPoints() const { return m_points.size(); }
+            unsigned int getNumFailed() const;
+
+            /*
+             * @return the frontier and the picked point as JSON
+             */
+            string getJSON() const;
+
+            /*
+             * @return the swept fields of a point, for a report
+             */
+            string describe(const designPoint& point) const;
+
+            /*
+             * @return the design score of the "Total Score" comment of the
+             *  emitted module, with the costs the config does not include
+             *  counted as one. Lower is better.
+             */
+            static double getScore(const designCost& cost, const resourceConfig& config);
+
+        private:
+            /// a swept field of the configuration
+            struct dimension {
+                string name;
+                unsigned int resourceConfig::*field;
+                vector<unsigned int> values;
+            };
+
+            /// fill m_points with every combination of the dimensions
+            void enumeratePoints();
+            /// set the pareto flag of the points
+            void markParetoFrontier();
+            /// @return true if 'a' is as good as 'b' in every cost and better in one
+            static bool dominates(const designCost& a, const designCost& b);
+            /// print one point as a JSON object
+            string getPointJSON(const designPoint& point) const;
+
+            resourceConfig m_base;
+            vector<dimension> m_dims;
+            vector<designPoint> m_points;
+    }; // class
+
+} //end of namespace
+#endif // h guard
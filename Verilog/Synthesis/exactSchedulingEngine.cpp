@@ -0,0 +1,221 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "exactSchedulingEngine.h"
+
+#include "llvm/Support/TimeValue.h"
+
+namespace xVerilog {
+
+    /*
+     * The state of the branch and bound search of one block
+     */
+    struct exactSearch {
+        /// the opcodes which each opcode depends on
+        vector<vector<unsigned int> > preds;
+        /// the length of each opcode, the distance to its dependent opcodes
+        vector<unsigned int> len;
+        /// the cycles of each opcode up to the last taken one
+        vector<unsigned int> extent;
+        /// the minimal distance from the start of each opcode to the end of the block
+        vector<unsigned int> tail;
+        /// the units each opcode may use
+        vector<vector<unsigned int> > units;
+        /// the non empty offsets of each opcode in each stream
+        vector<vector<vector<unsigned int> > > mask;
+        /// does the opcode have to come last
+        vector<char> last;
+        /// the units where opcodes never collide ('other')
+        vector<char> shared;
+
+        /// the occupancy bitmap of each stream of each unit
+        vector<vector<vector<uint64_t> > > busy;
+        /// the number of opcodes placed on each unit
+        vector<unsigned int> used;
+        /// the current placement
+        vector<unsigned int> start;
+        vector<unsigned int> unit;
+
+        /// the shortest schedule found so far
+        unsigned int best;
+        vector<unsigned int> bestStart;
+        vector<unsigned int> bestUnit;
+        bool found;
+
+        /// the search stops at the deadline
+        sys::TimeValue deadline;
+        unsigned int nodes;
+        bool timeout;
+    };
+
+    /// @return true if opcode i collides with unit u when it starts at s
+    static bool isTaken(exactSearch& S, unsigned int i, unsigned int u, unsigned int s) {
+        for (unsigned int st = 0; st < S.mask[i].size(); ++st) {
+            for (unsigned int k = 0; k < S.mask[i][st].size(); ++k) {
+                unsigned int c = s + S.mask[i][st][k];
+                if (S.busy[u][st][c/64] & (1ULL << (c%64))) return true;
+            }
+        }
+        return false;
+    }
+
+    /// Take or release the cycles of opcode i on unit u when it starts at s
+    static void toggle(exactSearch& S, unsigned int i, unsigned int u, unsigned int s) {
+        for (unsigned int st = 0; st < S.mask[i].size(); ++st) {
+            for (unsigned int k = 0; k < S.mask[i][st].size(); ++k) {
+                unsigned int c = s + S.mask[i][st][k];
+                S.busy[u][st][c/64] ^= (1ULL << (c%64));
+            }
+        }
+    }
+
+    /// Place opcodes i..n-1, the table is 'length' cycles long so far
+    static void search(exactSearch& S, unsigned int i, unsigned int length) {
+        if (S.timeout || length >= S.best) return;
+        if (0 == (++S.nodes % 1024) && sys::TimeValue::now() > S.deadline) {
+            S.timeout = true;
+            return;
+        }
+
+        if (i == S.len.size()) {
+            S.best = length;
+            S.bestStart = S.start;
+            S.bestUnit = S.unit;
+            S.found = true;
+            return;
+        }
+
+        // the difference constraints of the dependencies
+        unsigned int earliest = 0;
+        for (unsigned int k = 0; k < S.preds[i].size(); ++k) {
+            unsigned int p = S.preds[i][k];
+            earliest = std::max(earliest, S.start[p] + S.len[p]);
+        }
+        if (S.last[i] && length > 0) earliest = std::max(earliest, length - 1);
+
+        // the block must end before the best schedule does
+        if (earliest + S.tail[i] >= S.best) return;
+        unsigned int latest = S.best - 1 - S.tail[i];
+        // without a unit to share, starting later never helps
+        if (1 == S.units[i].size() && S.shared[S.units[i][0]]) latest = earliest;
+
+        for (unsigned int s = earliest; s <= latest; ++s) {
+            bool triedEmpty = false;
+            for (unsigned int k = 0; k < S.units[i].size(); ++k) {
+                unsigned int u = S.units[i][k];
+                bool shared = S.shared[u];
+                if (!shared) {
+                    // empty units of the same kind are interchangeable
+                    if (0 == S.used[u]) {
+                        if (triedEmpty) continue;
+                        triedEmpty = true;
+                    }
+                    if (isTaken(S, i, u, s)) continue;
+                    toggle(S, i, u, s);
+                }
+                S.used[u]++;
+                S.start[i] = s;
+                S.unit[i] = u;
+
+                search(S, i+1, std::max(length, s + S.extent[i]));
+
+                S.used[u]--;
+                if (!shared) toggle(S, i, u, s);
+                if (S.timeout) return;
+            }
+        }
+    }
+
+    string exactSchedulingEngine::getName() const {
+        stringstream ss;
+        ss<<m_heuristic.getName()<<"+exact/"<<m_maxOps<<"/"<<m_budgetMs;
+        return ss.str();
+    }
+
+    void exactSchedulingEngine::schedule(listScheduler* ls) const {
+        m_heuristic.schedule(ls);
+
+        vector<abstractHWOpcode*>& ops = ls->getOpcodes();
+        vector<resourceUnit*>& units = ls->getUnits();
+        unsigned int n = ops.size();
+        unsigned int heuristicLength = ls->length();
+        if (n > m_maxOps || heuristicLength < 2) return;
+
+        exactSearch S;
+        S.preds.resize(n);
+        S.len.resize(n);
+        S.extent.resize(n, 0);
+        S.tail.resize(n, 0);
+        S.units.resize(n);
+        S.mask.resize(n);
+        S.last.resize(n);
+        S.start.resize(n, 0);
+        S.unit.resize(n, 0);
+        S.best = heuristicLength;
+        S.found = false;
+        S.nodes = 0;
+        S.timeout = false;
+
+        DenseMap<abstractHWOpcode*, unsigned int> index;
+        unsigned int maxLength = 0;
+        for (unsigned int i = 0; i < n; ++i) {
+            abstractHWOpcode* op = ops[i];
+            index[op] = i;
+            S.len[i] = op->getLength();
+            S.last[i] = op->isMustBeLastOpcode();
+            maxLength = std::max(maxLength, S.len[i]);
+
+            const set<abstractHWOpcode*>& deps = op->getDependencies();
+            for (set<abstractHWOpcode*>::const_iterator it = deps.begin(); it != deps.end(); ++it) {
+                assert(index.count(*it) && "opcode depends on a later opcode");
+                S.preds[i].push_back(index[*it]);
+            }
+
+            S.mask[i].resize(op->getNumberOfStreams());
+            for (unsigned int st = 0; st < S.mask[i].size(); ++st) {
+                for (unsigned int c = 0; c < S.len[i]; ++c) {
+                    if (op->emptyAt(st, c)) continue;
+                    S.mask[i][st].push_back(c);
+                    S.extent[i] = std::max(S.extent[i], c+1);
+                }
+            }
+
+            for (unsigned int u = 0; u < units.size(); ++u) {
+                if (units[u]->isSameUnitType(op)) S.units[i].push_back(u);
+            }
+        }
+
+        // the longest path from each opcode to the end of the block
+        for (unsigned int i = n; i > 0; --i) {
+            unsigned int op = i-1;
+            S.tail[op] = std::max(S.tail[op], S.extent[op]);
+            for (unsigned int k = 0; k < S.preds[op].size(); ++k) {
+                unsigned int p = S.preds[op][k];
+                S.tail[p] = std::max(S.tail[p], S.len[p] + S.tail[op]);
+            }
+        }
+
+        unsigned int words = (heuristicLength + maxLength + 64) / 64;
+        S.busy.resize(units.size());
+        S.used.resize(units.size(), 0);
+        S.shared.resize(units.size());
+        for (unsigned int u = 0; u < units.size(); ++u) {
+            S.busy[u].resize(units[u]->getNumberOfStreams(), vector<uint64_t>(words, 0));
+            S.shared[u] = (units[u]->getName() == "other");
+        }
+
+        S.deadline = sys::TimeValue::now() +
+            sys::TimeValue(m_budgetMs / 1000, (m_budgetMs % 1000) * 1000000);
+        search(S, 0, 0);
+
+        // Keep the heuristic schedule unless the search found a shorter one.
+        // Every schedule it found is complete and valid, so the best one is
+        // used even if the budget ran out before the search was done.
+        if (!S.found) return;
+
+        ls->resetSchedule();
+        for (unsigned int i = 0; i < n; ++i) {
+            ls->placeOpcode(i, S.bestUnit[i], S.bestStart[i]);
+        }
+        ls->setHeuristicLength(heuristicLength);
+    }
+
+} // namespace
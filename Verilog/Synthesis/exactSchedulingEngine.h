@@ -0,0 +1,44 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_EXACT_SCHEDULING_ENGINE_H
+#define LLVM_EXACT_SCHEDULING_ENGINE_H
+
+#include "schedulingEngine.h"
+
+namespace xVerilog {
+
+    /*
+     * Finds the shortest schedule of a small block. The dependencies form a
+     *  system of difference constraints (start(b) - start(a) >= length(a)),
+     *  whose longest paths bound the start cycle of every opcode from below
+     *  and, given a schedule length, from above. A branch and bound search
+     *  then tries the start cycles and units of the opcodes in priority
+     *  order, and keeps the shortest schedule which does not overuse a unit.
+     *
+     *  The heuristic engine schedules the block first and its length is the
+     *  first bound. The search stops when the time budget runs out, with
+     *  the shortest schedule it found so far. If it found none, or the
+     *  block is too large, the heuristic schedule is kept.
+     */
+    class exactSchedulingEngine : public schedulingEngine {
+        public:
+            /*
+             * C'tor
+             * @param heuristic the engine whose schedule we try to improve
+             * @param maxOps blocks with more opcodes are not searched
+             * @param budgetMs the time budget of the search of one block
+             */
+            exactSchedulingEngine(const schedulingEngine& heuristic,
+                    unsigned int maxOps, unsigned int budgetMs):
+                m_heuristic(heuristic),m_maxOps(maxOps),m_budgetMs(budgetMs) {}
+
+            virtual string getName() const;
+            virtual void schedule(listScheduler* ls) const;
+
+        private:
+            const schedulingEngine& m_heuristic;
+            unsigned int m_maxOps;
+            unsigned int m_budgetMs;
+    }; // class
+
+} //end of namespace
+#endif // h guard
@@ -0,0 +1,199 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "forceDirectedEngine.h"
+
+namespace xVerilog {
+
+    /// the work (opcodes * frames) above which the block is list scheduled
+    static const double MaxForceWork = 5e7;
+
+    /*
+     * The opcodes of a block, as indices, with their time frames
+     */
+    struct forceGraph {
+        /// the opcodes each opcode depends on, and the ones depending on it
+        vector<vector<unsigned int> > preds;
+        vector<vector<unsigned int> > succs;
+        /// the length of each opcode in cycles
+        vector<unsigned int> len;
+        /// the kind of unit of each opcode, -1 for the unlimited 'other'
+        vector<int> kind;
+        /// the non empty offsets of each opcode in each stream
+        vector<vector<vector<unsigned int> > > mask;
+        /// the chosen start cycle of each opcode, -1 if not chosen yet
+        vector<int> fixed;
+        /// the frame of each opcode
+        vector<unsigned int> asap;
+        vector<unsigned int> alap;
+        /// the length of the block
+        unsigned int latency;
+    };
+
+    /// Calculate the ASAP and ALAP frame of each opcode
+    static void computeFrames(forceGraph& g) {
+        unsigned int n = g.len.size();
+        for (unsigned int i = 0; i < n; ++i) {
+            unsigned int a = 0;
+            for (unsigned int k = 0; k < g.preds[i].size(); ++k) {
+                unsigned int p = g.preds[i][k];
+                a = std::max(a, g.asap[p] + g.len[p]);
+            }
+            g.asap[i] = (g.fixed[i] >= 0) ? (unsigned int)g.fixed[i] : a;
+        }
+
+        for (unsigned int i = n; i > 0; --i) {
+            unsigned int op = i-1;
+            int b = (int)g.latency - (int)g.len[op];
+            for (unsigned int k = 0; k < g.succs[op].size(); ++k) {
+                unsigned int s = g.succs[op][k];
+                b = std::min(b, (int)g.alap[s] - (int)g.len[op]);
+            }
+            if (g.fixed[op] >= 0) b = g.fixed[op];
+            // resource delays may push an opcode beyond the critical path
+            g.alap[op] = std::max(b, (int)g.asap[op]);
+        }
+    }
+
+    /// Sum the probability of each opcode to use each cycle of each kind of unit
+    static void computeDistribution(forceGraph& g, vector<vector<vector<double> > >& dist) {
+        for (unsigned int t = 0; t < dist.size(); ++t) {
+            for (unsigned int s = 0; s < dist[t].size(); ++s) {
+                std::fill(dist[t][s].begin(), dist[t][s].end(), 0.0);
+            }
+        }
+        for (unsigned int i = 0; i < g.len.size(); ++i) {
+            if (g.kind[i] < 0) continue;
+            double p = 1.0 / (g.alap[i] - g.asap[i] + 1);
+            for (unsigned int c = g.asap[i]; c <= g.alap[i]; ++c) {
+                for (unsigned int s = 0; s < g.mask[i].size(); ++s) {
+                    vector<double>& d = dist[g.kind[i]][s];
+                    for (unsigned int k = 0; k < g.mask[i][s].size(); ++k) {
+                        unsigned int cycle = c + g.mask[i][s][k];
+                        if (cycle >= d.size()) d.resize(cycle+1, 0.0);
+                        d[cycle] += p;
+                    }
+                }
+            }
+        }
+    }
+
+    /// @return the expected usage of the units of opcode i if it starts at c
+    static double usageAt(forceGraph& g, vector<vector<vector<double> > >& dist,
+            unsigned int i, unsigned int c) {
+        double usage = 0;
+        for (unsigned int s = 0; s < g.mask[i].size(); ++s) {
+            vector<double>& d = dist[g.kind[i]][s];
+            for (unsigned int k = 0; k < g.mask[i][s].size(); ++k) {
+                unsigned int cycle = c + g.mask[i][s][k];
+                if (cycle < d.size()) usage += d[cycle];
+            }
+        }
+        return usage;
+    }
+
+    void forceDirectedEngine::schedule(listScheduler* ls) const {
+        vector<abstractHWOpcode*>& ops = ls->getOpcodes();
+        unsigned int n = ops.size();
+
+        forceGraph g;
+        g.preds.resize(n);
+        g.succs.resize(n);
+        g.len.resize(n);
+        g.kind.resize(n);
+        g.mask.resize(n);
+        g.fixed.resize(n, -1);
+        g.asap.resize(n, 0);
+        g.alap.resize(n, 0);
+        g.latency = 0;
+
+        DenseMap<abstractHWOpcode*, unsigned int> index;
+        map<string, unsigned int> kinds;
+        unsigned int streams = 0;
+        vector<unsigned int> candidates;
+        for (unsigned int i = 0; i < n; ++i) {
+            abstractHWOpcode* op = ops[i];
+            index[op] = i;
+            g.len[i] = op->getLength();
+
+            const set<abstractHWOpcode*>& deps = op->getDependencies();
+            for (set<abstractHWOpcode*>::const_iterator it = deps.begin(); it != deps.end(); ++it) {
+                assert(index.count(*it) && "opcode depends on a later opcode");
+                g.preds[i].push_back(index[*it]);
+                g.succs[index[*it]].push_back(i);
+            }
+
+            g.kind[i] = -1;
+            if (op->getName() == "other" || 0 == g.len[i]) continue;
+            if (!kinds.count(op->getName())) {
+                unsigned int k = kinds.size();
+                kinds[op->getName()] = k;
+            }
+            g.kind[i] = kinds[op->getName()];
+            g.mask[i].resize(op->getNumberOfStreams());
+            streams = std::max(streams, op->getNumberOfStreams());
+            for (unsigned int s = 0; s < g.mask[i].size(); ++s) {
+                for (unsigned int c = 0; c < g.len[i]; ++c) {
+                    if (!op->emptyAt(s, c)) g.mask[i][s].push_back(c);
+                }
+            }
+            candidates.push_back(i);
+        }
+
+        // the critical path is the length of the block
+        computeFrames(g);
+        for (unsigned int i = 0; i < n; ++i) {
+            g.latency = std::max(g.latency, g.asap[i] + g.len[i]);
+        }
+
+        if ((double)candidates.size() * n * (g.latency+1) > MaxForceWork) {
+            // too expensive, the list scheduler is good enough here
+            listSchedulingEngine().schedule(ls);
+            return;
+        }
+
+        vector<vector<vector<double> > > dist(kinds.size(),
+                vector<vector<double> >(streams, vector<double>(g.latency+1, 0.0)));
+
+        for (unsigned int step = 0; step < candidates.size(); ++step) {
+            computeFrames(g);
+            computeDistribution(g, dist);
+
+            int bestOp = -1;
+            unsigned int bestCycle = 0;
+            double bestForce = 0;
+            for (unsigned int k = 0; k < candidates.size(); ++k) {
+                unsigned int i = candidates[k];
+                if (g.fixed[i] >= 0) continue;
+
+                // the force is the usage at the cycle minus the average usage
+                // over the frame of the opcode
+                unsigned int width = g.alap[i] - g.asap[i] + 1;
+                vector<double> usage(width);
+                double average = 0;
+                for (unsigned int c = 0; c < width; ++c) {
+                    usage[c] = usageAt(g, dist, i, g.asap[i] + c);
+                    average += usage[c];
+                }
+                average /= width;
+
+                for (unsigned int c = 0; c < width; ++c) {
+                    double force = usage[c] - average;
+                    if (bestOp < 0 || force < bestForce) {
+                        bestOp = i;
+                        bestCycle = g.asap[i] + c;
+                        bestForce = force;
+                    }
+                }
+            }
+            assert(bestOp >= 0 && "no opcode left to fix");
+            g.fixed[bestOp] = bestCycle;
+        }
+
+        // Place the opcodes at their cycles. Opcodes which do not need a unit
+        // start as soon as their dependencies are done.
+        for (unsigned int i = 0; i < n; ++i) {
+            unsigned int earliest = (g.fixed[i] >= 0) ? g.fixed[i] : 0;
+            ls->placeOnBestUnit(i, earliest);
+        }
+    }
+
+} // namespace
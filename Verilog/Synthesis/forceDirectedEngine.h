@@ -0,0 +1,28 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_FORCE_DIRECTED_ENGINE_H
+#define LLVM_FORCE_DIRECTED_ENGINE_H
+
+#include "schedulingEngine.h"
+
+namespace xVerilog {
+
+    /*
+     * Force directed scheduling (Paulin and Knight). The length of the block
+     *  is fixed to its critical path. Each opcode which needs an execution
+     *  unit may start anywhere in its [ASAP, ALAP] frame, with an equal
+     *  probability. The sum of the probabilities gives the expected usage of
+     *  each kind of unit in each cycle. One at a time, the opcode and cycle
+     *  with the lowest force (the increase in the expected usage) are fixed
+     *  and the frames of the other opcodes shrink. This spreads the multiplies
+     *  and memory accesses over the block, so fewer units are used at once.
+     *  Finally the opcodes are placed in the table, at their chosen cycle or
+     *  later if all of the units are taken.
+     */
+    class forceDirectedEngine : public schedulingEngine {
+        public:
+            virtual string getName() const { return "fds"; }
+            virtual void schedule(listScheduler* ls) const;
+    }; // class
+
+} //end of namespace
+#endif // h guard
@@ -31,6 +31,12 @@ namespace xVerilog {
             delete it->second;
         }
 
+        m_map.clear();
+
+        releaseGarbage();
+    }
+
+    void globalVarRegistry::releaseGarbage() {
         // For each load instruction that we have modified
         for (vector<Instruction*>::iterator it = m_garbage.begin(); it!=m_garbage.end();it++) {
             // Replace the users of this dummy instruction with zero;
@@ -38,6 +44,7 @@ namespace xVerilog {
             // And delete it
             delete *it;
         }
+        m_garbage.clear();
     }
 
     const Type* globalVarRegistry::bitNumToType(int bitnum){
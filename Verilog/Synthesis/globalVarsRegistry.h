@@ -48,8 +48,18 @@ namespace xVerilog {
 
             }
 
+            /*
+             * destroy all of the global variables and the garbage. Clears the
+             * registry so it can be initialized again.
+             */
             void destroy();
 
+            /*
+             * delete the instructions which were parked with trashWhenDone. 
+             * Called after each function is emitted, when nothing refers to them.
+             */
+            void releaseGarbage();
+
             /*
              * add this variable to a list of instructions to be destructed on exit
              */
@@ -1,11 +1,62 @@
 /* Nadav Rotem  - C-to-Verilog.com */
 #include "instPriority.h"
 
+#include <queue>
+
 namespace xVerilog {
 
+    /*
+     * The order of the ready list of getCriticalPathOrder: PHINodes first,
+     *  then the greater height, the smaller mobility, the more successors
+     *  and the earlier instruction. Returns true if 'a' comes after 'b'.
+     */
+    struct readyOrder {
+        readyOrder(const vector<bool>& phi, const vector<unsigned int>& height,
+                const vector<unsigned int>& mobility, const vector<vector<unsigned int> >& succs):
+            phi(phi),height(height),mobility(mobility),succs(succs) {}
+
+        bool operator()(unsigned int a, unsigned int b) const {
+            if (phi[a] != phi[b]) return phi[b];
+            if (height[a] != height[b]) return height[a] < height[b];
+            if (mobility[a] != mobility[b]) return mobility[a] > mobility[b];
+            if (succs[a].size() != succs[b].size()) return succs[a].size() < succs[b].size();
+            return a > b;
+        }
+
+        const vector<bool>& phi;
+        const vector<unsigned int>& height;
+        const vector<unsigned int>& mobility;
+        const vector<vector<unsigned int> >& succs;
+    };
+
     instructionPriority::instructionPriority(BasicBlock* BB) {
         this->BB = BB;
-        calculateDeps();
+        m_blocks.insert(BB);
+        readDependencies(vector<BasicBlock*>(1, BB));
+    }
+
+    instructionPriority::instructionPriority(const vector<BasicBlock*>& blocks) {
+        assert(!blocks.empty() && "empty trace");
+        this->BB = blocks.front();
+        m_blocks.insert(blocks.begin(), blocks.end());
+        readDependencies(blocks);
+    }
+
+    void instructionPriority::readDependencies(const vector<BasicBlock*>& blocks) {
+        // remember the dependencies, the lowering replaces some of them
+        for (unsigned int b = 0; b < blocks.size(); ++b) {
+            for (BasicBlock::iterator I = blocks[b]->begin(), E = blocks[b]->end(); I != E; ++I) {
+                m_index[I] = m_insts.size();
+                m_insts.push_back(I);
+            }
+        }
+        m_preds.resize(m_insts.size());
+        for (unsigned int i = 0; i < m_insts.size(); ++i) {
+            set<Instruction*> deps = getDependencies(m_insts[i]);
+            for (set<Instruction*>::iterator dp = deps.begin(); dp != deps.end(); ++dp) {
+                m_preds[i].push_back(m_index[*dp]);
+            }
+        }
     }
 
     unsigned int instructionPriority::getLocalUses(Instruction* inst) {
@@ -35,7 +86,7 @@ namespace xVerilog {
                 dep_iter != inst->op_end(); ++dep_iter){
             // if this dep is an instruction rather then a parameter
             if (Instruction* dep = dyn_cast<Instruction>(*dep_iter)) {
-                if (dep->getParent() == BB)
+                if (m_blocks.count(dep->getParent()))
                     deps.insert(dep);
             }
         }
@@ -96,6 +147,8 @@ namespace xVerilog {
         // terminators MUST come at the end of all opcodes
         InstructionVector terminators; 
 
+        // only the BFS order needs the layers
+        if (m_depth.empty()) calculateDeps();
         assert (m_depth.size() == BB->size() && "Map and BB are in different sizes");
 
         unsigned int maximum = 0;
@@ -104,16 +157,18 @@ namespace xVerilog {
             maximum = std::max(it->second,maximum);
         }
 
-        // start putting them in the layers, from last to first
+        // start putting them in the layers, from last to first. Inside a
+        // layer the instructions keep the order of the block, so the order
+        // does not depend on where the instructions are in memory.
         for (unsigned int iter=maximum+1; iter>0; --iter) {
-            for (InstPriorityMap::iterator it = m_depth.begin(); it != m_depth.end(); ++it) {
+            for (InstructionVector::iterator it = m_insts.begin(); it != m_insts.end(); ++it) {
                 // if it is the turn of this BFS layer
-                if ((iter-1) == it->second) {
+                if ((iter-1) == m_depth[*it]) {
                     // terminators come at the end
-                    if (it->first->isTerminator()) {
-                        terminators.push_back(it->first);
+                    if ((*it)->isTerminator()) {
+                        terminators.push_back(*it);
                     } else {
-                        order.push_back(it->first);
+                        order.push_back(*it);
                     }
                 }
             }
@@ -124,5 +179,89 @@ namespace xVerilog {
         return order;
     }
 
+    void instructionPriority::addDependency(Instruction* inst, Instruction* dep) {
+        assert(m_index.count(inst) && m_index.count(dep) && "instruction not in the trace");
+        assert(m_index[dep] < m_index[inst] && "dependency on a later instruction");
+        m_preds[m_index[inst]].push_back(m_index[dep]);
+    }
+
+    InstructionVector instructionPriority::getCriticalPathOrder(const InstPriorityMap& lengths) {
+        unsigned int n = m_insts.size();
+        vector<unsigned int> len(n, 0);
+        vector<vector<unsigned int> > succs(n);
+        for (unsigned int i = 0; i < n; ++i) {
+            InstPriorityMap::const_iterator it = lengths.find(m_insts[i]);
+            if (it != lengths.end()) len[i] = it->second;
+            for (unsigned int k = 0; k < m_preds[i].size(); ++k) {
+                succs[m_preds[i][k]].push_back(i);
+            }
+        }
+
+        // The dependencies go from earlier to later instructions, except for
+        // the ones of PHINodes, which we do not count.
+        vector<unsigned int> asap(n, 0);
+        unsigned int length = 0;
+        for (unsigned int i = 0; i < n; ++i) {
+            for (unsigned int k = 0; k < m_preds[i].size(); ++k) {
+                unsigned int p = m_preds[i][k];
+                asap[i] = std::max(asap[i], asap[p] + len[p]);
+            }
+            length = std::max(length, asap[i] + len[i]);
+        }
+
+        // the height is the distance from the start to the end of the block
+        vector<unsigned int> height(n, 0);
+        for (unsigned int i = n; i > 0; --i) {
+            unsigned int op = i-1;
+            height[op] = std::max(height[op], len[op]);
+            for (unsigned int k = 0; k < m_preds[op].size(); ++k) {
+                unsigned int p = m_preds[op][k];
+                height[p] = std::max(height[p], len[p] + height[op]);
+            }
+        }
+
+        // mobility = ALAP - ASAP, where ALAP = length - height
+        vector<unsigned int> mobility(n);
+        for (unsigned int i = 0; i < n; ++i) {
+            mobility[i] = length - height[i] - asap[i];
+        }
+
+        vector<bool> phi(n);
+        for (unsigned int i = 0; i < n; ++i) {
+            phi[i] = isa<PHINode>(m_insts[i]);
+        }
+
+        // list the instructions whose dependencies are listed, best first
+        vector<unsigned int> waiting(n);
+        readyOrder cmp(phi, height, mobility, succs);
+        std::priority_queue<unsigned int, vector<unsigned int>, readyOrder> ready(cmp);
+        InstructionVector order;
+        InstructionVector terminators;
+        for (unsigned int i = 0; i < n; ++i) {
+            waiting[i] = m_preds[i].size();
+            if (0 == waiting[i]) ready.push(i);
+        }
+
+        while (!ready.empty()) {
+            unsigned int i = ready.top();
+            ready.pop();
+            // the terminator of the trace comes at the end
+            if (i+1 == n) {
+                terminators.push_back(m_insts[i]);
+            } else {
+                order.push_back(m_insts[i]);
+            }
+            for (unsigned int k = 0; k < succs[i].size(); ++k) {
+                unsigned int s = succs[i][k];
+                if (0 == --waiting[s]) ready.push(s);
+            }
+        }
+
+        // put terminators at the end of the order list
+        order.insert(order.end(), terminators.begin(), terminators.end());
+        assert (order.size() == n && "Returning list in different sizes");
+        return order;
+    }
+
 
 } // namespace
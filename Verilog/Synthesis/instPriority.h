@@ -32,6 +32,14 @@ namespace xVerilog {
     using std::vector;
     using std::map;
 
+    /// the order in which the opcodes of a block are prioritized
+    enum priorityKind {
+        /// the unit weight BFS depth from the sinks of the block
+        BFSPriority,
+        /// the latency weighted critical path, then the mobility
+        CriticalPathPriority
+    };
+
     /*
      * This class gives a scheduling priority for each one of the instructions
      * in a basic block based on a reasonable order. It gives
@@ -43,15 +51,46 @@ namespace xVerilog {
 
             /*
              *C'tor
+             * Reads the dependencies of the instructions, before the lowering
+             * of the block changes them.
              */
             instructionPriority(BasicBlock* BB);
+            /*
+             *C'tor
+             * Prioritizes the instructions of a superblock, a trace of blocks
+             * where each block is the only predecessor of the next one. Only
+             * getCriticalPathOrder works on a trace.
+             */
+            instructionPriority(const vector<BasicBlock*>& blocks);
+
+            /*
+             * Declare that instruction 'inst' comes after instruction 'dep',
+             * which is before it in the block or in the trace.
+             */
+            void addDependency(Instruction* inst, Instruction* dep);
 
             /** 
-             * @brief return a topologically ordered instruction list
+             * @brief return a topologically ordered instruction list. The BFS
+             * layers are found on the first call, which must come before the
+             * lowering changes the block.
              * @return InstructionVector of instructions. First instruction should be
              * scheduled first.
              */
             InstructionVector getOrderedInstructions(); 
+
+            /** 
+             * @brief return a topologically ordered instruction list, by the
+             * latency weighted height of each instruction (the length of the
+             * longest path from its start to the end of the block). Ties go
+             * to the instruction with the smaller mobility (ALAP - ASAP), then
+             * to the one with more successors. PHINodes come first and the 
+             * terminator of the last block comes last.
+             * @param lengths the length of the opcode of each instruction, the
+             * distance to the instructions which depend on it
+             * @return InstructionVector of instructions. First instruction should be
+             * scheduled first.
+             */
+            InstructionVector getCriticalPathOrder(const InstPriorityMap& lengths);
         private:
             /** 
              * @brief Returns the number of uses this inst has
@@ -71,9 +110,24 @@ namespace xVerilog {
              */
             void calculateDeps();
 
+            /*
+             * Remember the instructions and their dependencies, before the
+             * lowering changes them.
+             */
+            void readDependencies(const vector<BasicBlock*>& blocks);
+
             /// Holds the depth of each of the elements in the graph
             InstPriorityMap m_depth; 
 
+            /// the blocks of the trace, the dependencies stay inside them
+            set<BasicBlock*> m_blocks;
+            /// the instructions of the block, in order
+            InstructionVector m_insts;
+            /// the position of each instruction in m_insts
+            InstPriorityMap m_index;
+            /// the instructions each instruction depends on, as positions
+            vector<vector<unsigned int> > m_preds;
+
             /// hold the BasicBlock
             BasicBlock* BB;
     }; //class
@@ -1,51 +1,21 @@
 /* Nadav Rotem  - C-to-Verilog.com */
 #include "listScheduler.h"
 #include "instPriority.h"
+#include "schedulingEngine.h"
+#include "backendStats.h"
+#include "scheduleTrace.h"
 
 namespace xVerilog {
 
-    resourceUnit::resourceUnit(string name, unsigned int id, unsigned int streamNum):
-        m_name(name),m_id(id),m_seq(streamNum) {
-            this->enlargeResourceTable(40);
-        }
-
-    void resourceUnit::enlargeResourceTable(unsigned int newSize) {
-        assert(newSize < 1000000 && "Piecetable should not exceed 1M items");
-        for (unsigned int j=0; j<m_seq.size(); j++) { // for each stream
-            for (unsigned int i=m_seq[j].size(); i<newSize+1;i++) {  // insert blank cycles
-                m_seq[j].push_back(InstructionCycle());
-            }
-        }
-    }
-
-    unsigned int resourceUnit::length() {
-        unsigned int max = 0;
-        for (unsigned int i=0; i<m_seq.size(); i++) {
-            // the length of the max stream
-            max = std::max(max, length(i));
-        }
-        return max;
-    }
-    unsigned int resourceUnit::length(unsigned int streamID) {
-        unsigned int len = 0;
-        // for both streams, look for the last opcode
-        for (unsigned int i=0; i<m_seq[streamID].size();i++) {
-            if (0 != m_seq[streamID][i].size()) {
-                // opcode in here!
-                len = i +1;  //size if last opcode index plus one
-            }
-        }
-        return len; 
-    }
-
+    resourceUnit::resourceUnit(string name, unsigned int id, unsigned int streamNum,
+            PlacementMap* placements):
+        m_name(name),m_id(id),m_tables(streamNum),m_placements(placements),m_length(0),m_taken(0) {}
 
     bool resourceUnit::hasInstruction(Instruction* inst) {
 
-        for (unsigned int sq=0; sq<m_seq.size();sq++) { // stream
-            for (unsigned int i=0; i<m_seq[sq].size();i++) { // cycle
-                for (unsigned int j=0; j<m_seq[sq][i].size(); j++) { // instruction in cycle
-                    if (inst == m_seq[sq][i][j]) return true;
-                }
+        for (unsigned int sq=0; sq<m_tables.size();sq++) { // stream
+            for (reservationTable::iterator i = m_tables[sq].begin(); i != m_tables[sq].end(); ++i) { // cycle
+                if (std::find(i->second.begin(), i->second.end(), inst) != i->second.end()) return true;
             }
         }
         return false; 
@@ -53,85 +23,94 @@ namespace xVerilog {
 
     InstructionCycle resourceUnit::getInstructionForCycle(unsigned int cycleNum) {
         InstructionCycle cycle;
-        for (unsigned int sq=0; sq<m_seq.size();sq++) { // stream
-            this->enlargeResourceTable(cycleNum);
-            assert(m_seq[sq].size() > cycleNum && "Cycle num is to large");
-            cycle.insert(cycle.begin(), m_seq[sq][cycleNum].begin(), m_seq[sq][cycleNum].end());
+        for (unsigned int sq=0; sq<m_tables.size();sq++) { // stream
+            const InstructionCycle* insts = m_tables[sq].getInstructions(cycleNum);
+            if (!insts) continue;
+            cycle.insert(cycle.begin(), insts->begin(), insts->end());
         }
         return cycle;
     }
 
-    bool resourceUnit::emptyAt(unsigned int streamID, unsigned int cycle) {
-        this->enlargeResourceTable(cycle);
-        assert(cycle < m_seq[streamID].size() && "placing instruction out of piecetable");
-        return (0 == m_seq[streamID][cycle].size());
-    }
-
-    unsigned int resourceUnit::getBestSchedulingCycle(abstractHWOpcode* op) {
+    unsigned int resourceUnit::getBestSchedulingCycle(abstractHWOpcode* op, unsigned int earliest) {
 
-        unsigned int start = op->getFirstSchedulableSlot();
+        unsigned int start = std::max(op->getFirstSchedulableSlot(), earliest);
         // "other units" may schedule on any available slot
         if (this->getName() == "other") return start;
 
+        // the occupancy mask of the opcode: the runs of non empty cycles in
+        // each of the streams, as (offset, number of cycles)
+        vector<vector<pair<unsigned int, unsigned int> > > mask(m_tables.size());
+        for (unsigned int strm=0; strm < m_tables.size(); strm++) {
+            for(unsigned int i=0; i<op->getLength(); i++) {
+                if (op->emptyAt(strm, i)) continue;
+                if (i && !op->emptyAt(strm, i-1)) {
+                    mask[strm].back().second++;
+                } else {
+                    mask[strm].push_back(std::make_pair(i, 1U));
+                }
+            }
+        }
 
         // search for an available slot:
-        // move starting slot one forward and try to schedule slot
+        // each run of the mask finds the first free window which holds it
+        // in its stream. Move the start to the latest of them until every
+        // run of the mask fits at the same start. An opcode with a single
+        // run, which most are, needs one lookup.
         while (true) {
-            bool fit = true;
-            for (unsigned int strm=0; strm < m_seq.size(); strm++) {
-                for(unsigned int i=0; i<op->getLength(); i++) {
-                    // if opcode cycle is not empty and also resource is not empty at this point
-                    if (!op->emptyAt(strm, i) && !emptyAt(strm, i+start)) {
-                        // then this place is not available
-                        fit = false;
-                    }
+            unsigned int next = start;
+            for (unsigned int strm=0; strm < m_tables.size(); strm++) {
+                for (unsigned int i=0; i<mask[strm].size(); i++) {
+                    unsigned int offset = mask[strm][i].first;
+                    unsigned int fit = m_tables[strm].findFirstFit(start + offset, mask[strm][i].second);
+                    next = std::max(next, fit - offset);
                 }
-            }//stream
-            if (fit) {
-                return start;
             }
-            ++start;
+            if (next == start) return start;
+            start = next;
         }
     }
 
     void resourceUnit::place(abstractHWOpcode* op, unsigned int place) {
 
-        this->enlargeResourceTable(place);
-        assert(place < m_seq[0].size() && "placing instruction out of piecetable");
-
         op->place(place, getId());
         // for each stream in the opcode
-        for (unsigned int strm=0; strm < m_seq.size(); strm++) {
+        for (unsigned int strm=0; strm < m_tables.size(); strm++) {
             // for each cycle in the hardware opcode
             for(unsigned int i=0; i<op->getLength(); i++) {
+                // a held cycle of a unit which is not pipelined has no operations
+                if (op->emptyAt(strm,i)) continue;
                 // for each operation
                 InstructionCycle cycle = op->cycleAt(strm,i);
                 for (InstructionCycle::iterator it = cycle.begin(); it!=cycle.end();it++) {
-                    // add the operation to the local sequence of operations
-                    m_seq[strm][place+i].push_back(*it);
+                    // remember where the operation is, the first cycle wins
+                    if (m_placements && !m_placements->count(*it)) {
+                        (*m_placements)[*it] = PlacementInfo(getId(), place+i);
+                    }
                 }
+                // take the cycle and add the operations to it
+                unsigned int taken = m_tables[strm].takenSlots();
+                m_tables[strm].reserve(place+i, cycle);
+                m_taken += m_tables[strm].takenSlots() - taken;
+                m_length = std::max(m_length, place+i+1);
             } 
         }
     }
 
     string resourceUnit::toString() {
         std::stringstream sb;
-        for (unsigned strm=0; strm<m_seq.size(); strm++) {
+        for (unsigned strm=0; strm<m_tables.size(); strm++) {
 
             // check if this instruction unit is empty
-            bool empty_unit = true;
-            for (unsigned int j=0; j<m_seq[strm].size();j++) {
-                if (0!=m_seq[strm][j].size()) empty_unit = false;
-            }
-            if (empty_unit) continue; 
+            if (0 == m_tables[strm].length()) continue; 
 
             sb<<getName()<<"_"<<strm<<"    \t";
             for (unsigned int j=0; j<30;j++) {
-                unsigned int sz = m_seq[strm][j].size();
+                const InstructionCycle* insts = m_tables[strm].getInstructions(j);
+                unsigned int sz = insts ? insts->size() : 0;
                 if (0==sz) {
                     sb<<"."; 
                 } else if (sz<10) {
-                    sb<<m_seq[strm][j].size();
+                    sb<<sz;
                 } else {
                     sb<<"*"; 
                 }
@@ -141,24 +120,10 @@ namespace xVerilog {
         return sb.str();
     }
 
-    unsigned int resourceUnit::takenSlots() {
-        unsigned int slots = 0;
-        for (unsigned j=0; j<m_seq.size(); j++) {
-            // for all streams, look at all opcodes
-            for (unsigned int i=0; i<m_seq[j].size();i++) {
-                if (0 != m_seq[j][i].size()) {
-                    // opcode in here!
-                    slots++;
-                }
-            }
-        }
-        return slots;
-    }
-
 
     resourceUnit* resourceUnit::getLeastBusyResource(vector<resourceUnit*> availableResources) {
         resourceUnit* best = NULL;
-        unsigned int less = 10000;
+        unsigned int less = ~0U;
         for (vector<resourceUnit*>::iterator un = availableResources.begin(); 
                 un!=availableResources.end();++un) {
             if ((*un)->takenSlots() < less) {
@@ -172,38 +137,113 @@ namespace xVerilog {
 
     /// list scheduler below
 
-    listScheduler::listScheduler(BasicBlock* BB,llvm::TargetData* TD):TD(TD),//JAWAD
-        m_bb(BB),
+    listScheduler::listScheduler(BasicBlock* BB,llvm::TargetData* TD, schedulingArena* arena,
+            const resourceConfig& config, priorityKind priority):TD(TD),//JAWAD
+        m_bb(BB),m_blocks(1, BB),m_arena(arena),m_config(config),m_length(0),m_version(0),
+        m_heuristicLength(0),m_hasDependencies(false),m_ii(0),m_stages(1),
         m_memoryPorts(getMemoryPortDeclerations(BB->getParent(),TD)) { //JAWAD
 
-            map<string, unsigned int> rt =  machineResourceConfig::getResourceTable();
+            createUnits();
+            lowerBlocks(priority);
+        }
 
-            for (MemportMap::iterator k = m_memoryPorts.begin(); k!=m_memoryPorts.end(); ++k) {
-                // Add a 'resource' with this name
-                addResource("mem_" + k->first, rt["memport"]);
-            }
+    listScheduler::listScheduler(const vector<BasicBlock*>& blocks,llvm::TargetData* TD,
+            schedulingArena* arena, const resourceConfig& config, priorityKind priority):TD(TD),
+        m_bb(blocks.front()),m_blocks(blocks),m_arena(arena),m_config(config),m_length(0),m_version(0),
+        m_heuristicLength(0),m_hasDependencies(false),m_ii(0),m_stages(1),
+        m_memoryPorts(getMemoryPortDeclerations(blocks.front()->getParent(),TD)) {
 
-            addResource("mul", rt["mul"]);
-            addResource("div", rt["div"]);
-            addResource("shl", rt["shl"]);
-            addResource("other",1);
+            createUnits();
+            lowerBlocks(priority);
+        }
 
-            scheduleBasicBlock(BB);
+    void listScheduler::createUnits() {
+        for (MemportMap::iterator k = m_memoryPorts.begin(); k!=m_memoryPorts.end(); ++k) {
+            // Add a 'resource' with this name
+            addResource("mem_" + k->first, m_config.units_memport);
         }
 
+        addResource("mul", m_config.units_mul);
+        addResource("div", m_config.units_div);
+        addResource("shl", m_config.units_shl);
+        addResource("other",1);
+    }
+
+    void listScheduler::resetSchedule() {
+        // the old units stay in the arena until the function is done
+        m_units.clear();
+        m_placements.clear();
+        m_opUnits.clear();
+        m_decisions.clear();
+        m_length = 0;
+        m_version++;
+        createUnits();
+    }
+
+    void listScheduler::setModuloSchedule(unsigned int ii, unsigned int stages, 
+            const PhiCopyList& copies) {
+        m_ii = ii;
+        m_stages = stages;
+        m_phiCopies = copies;
+    }
+
+    unsigned int listScheduler::getHeuristicLength() {
+        if (m_heuristicLength) return m_heuristicLength;
+        return length();
+    }
+
     vector<Instruction*> listScheduler::getInstructionForCycle(unsigned int cycleNum) {
         vector<Instruction*> ret;
-        // for each unit in the processor
-        for (vector<resourceUnit*>::iterator it = m_units.begin(); it!=m_units.end(); ++it) {
-            // for each of the collection of cycles from the different units
-            InstructionCycle cycle = (*it)->getInstructionForCycle(cycleNum);
-            for (InstructionCycle::iterator ins = cycle.begin(); ins!=cycle.end(); ++ins) {
-                ret.push_back(*ins);
-            }
+        const scheduleView& view = getScheduleView();
+        if (cycleNum >= view.getNumberOfCycles()) return ret;
+        for (scheduleView::iterator it = view.begin(cycleNum); it != view.end(cycleNum); ++it) {
+            ret.push_back(it->inst);
         }
         return ret; 
     }
 
+    const scheduleView& listScheduler::getScheduleView() {
+        if (m_view.m_valid && m_view.m_version == m_version) return m_view;
+
+        // count the instructions of each cycle, then fill each cycle in
+        // the order of getInstructionForCycle: by unit, the last stream of
+        // a unit first
+        unsigned int cycles = length();
+        vector<unsigned int>& offsets = m_view.m_offsets;
+        offsets.assign(cycles + 1, 0);
+        for (vector<resourceUnit*>::iterator un = m_units.begin(); un!=m_units.end(); ++un) {
+            for (unsigned int strm = 0; strm < (*un)->getNumberOfStreams(); ++strm) {
+                const reservationTable& table = (*un)->getStream(strm);
+                for (reservationTable::iterator it = table.begin(); it != table.end(); ++it) {
+                    offsets[it->first + 1] += it->second.size();
+                }
+            }
+        }
+        for (unsigned int cycle = 0; cycle < cycles; ++cycle) {
+            offsets[cycle + 1] += offsets[cycle];
+        }
+
+        vector<scheduleView::entry>& entries = m_view.m_entries;
+        entries.resize(offsets[cycles]);
+        vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+        for (vector<resourceUnit*>::iterator un = m_units.begin(); un!=m_units.end(); ++un) {
+            for (unsigned int strm = (*un)->getNumberOfStreams(); strm > 0; --strm) {
+                const reservationTable& table = (*un)->getStream(strm - 1);
+                for (reservationTable::iterator it = table.begin(); it != table.end(); ++it) {
+                    for (InstructionCycle::const_iterator I = it->second.begin(); I != it->second.end(); ++I) {
+                        scheduleView::entry& e = entries[next[it->first]++];
+                        e.inst = *I;
+                        e.unit = (*un)->getId();
+                    }
+                }
+            }
+        }
+
+        m_view.m_valid = true;
+        m_view.m_version = m_version;
+        return m_view;
+    }
+
 
 
 
@@ -220,90 +260,299 @@ namespace xVerilog {
 
 
 
-    unsigned int listScheduler::length() {
-        unsigned int len = 0;
-        for(vector<resourceUnit*>::iterator it = m_units.begin(); it!=m_units.end(); ++it) {
-            len = std::max(len, (*it)->length());
-        }
-        return len;
-    }
-
-
-
     unsigned int listScheduler::getResourceIdForInstruction(Instruction* inst) {
-        for(vector<resourceUnit*>::iterator it = m_units.begin(); it!=m_units.end(); ++it) {
-            if ((*it)->hasInstruction(inst)) return (*it)->getId();
-        }
+        PlacementMap::iterator it = m_placements.find(inst);
+        if (it != m_placements.end()) return it->second.first;
         std::cerr<<"unable to find the resource unit for instruction "<<inst<<"\n";
         abort();
         return 0;
     }
 
+    unsigned int listScheduler::getCycleForInstruction(Instruction* inst) {
+        PlacementMap::iterator it = m_placements.find(inst);
+        if (it != m_placements.end()) return it->second.second;
+        std::cerr<<"unable to find the cycle for instruction "<<inst<<"\n";
+        abort();
+        return 0;
+    }
+
 
     void listScheduler::addResource(string name, unsigned int count) {
         for (unsigned int i=0; i<count;i++)
-            m_units.push_back(new resourceUnit(name, i, 2));
+            m_units.push_back(m_arena->create<resourceUnit>(name, i,
+                        m_config.getResourceClass(name).getNumberOfStreams(), &m_placements));
     }
 
 
 
 
-    /// This is the heart of the list scheduler, the "do-it-all" algorithem
+    /*
+     * @return true if 'inst' may start before the side exit which guards it.
+     *  It has no side effects and its unit takes new operands every cycle,
+     *  so an operation which is dropped by the side exit does not keep the
+     *  unit busy.
+     */
+    static bool isSpeculable(Instruction* inst, const resourceConfig& config) {
+        if (inst->isTerminator() || isa<PHINode>(inst) || isa<CallInst>(inst)) return false;
+        if (inst->mayHaveSideEffects()) return false;
+        if (BinaryOperator* bin = dyn_cast<BinaryOperator>(inst)) {
+            switch (bin->getOpcode()) {
+                case Instruction::Mul: return 1 == config.getResourceClass("mul").ii;
+                case Instruction::SDiv: return 1 == config.getResourceClass("div").ii;
+                case Instruction::Shl:
+                    return isa<Constant>(bin->getOperand(1)) || 1 == config.getResourceClass("shl").ii;
+                default: return true;
+            }
+        }
+        return true;
+    }
+
+    BasicBlock* listScheduler::getTraceSuccessor(BasicBlock* BB) {
+        for (unsigned int i = 0; i+1 < m_blocks.size(); ++i) {
+            if (m_blocks[i] == BB) return m_blocks[i+1];
+        }
+        return NULL;
+    }
 
-    void listScheduler::scheduleBasicBlock(BasicBlock* BB) {
+    void listScheduler::lowerBlocks(priorityKind priority) {
         // create the "abstract Hardware Opcodes"
 
-        instructionPriority prioritizer(BB);
-        InstructionVector order = prioritizer.getOrderedInstructions();
+        string stateName = toPrintable(m_bb->getName());
 
+        if (BFSPriority == priority && 1 == m_blocks.size()) {
+            InstructionVector order;
+            {
+                phaseTimer timer("lower/priority");
+                instructionPriority prioritizer(m_bb);
+                order = prioritizer.getOrderedInstructions();
+            }
+            for (InstructionVector::iterator I = order.begin(), E = order.end(); I != E; ++I) {
+                abstractHWOpcode *op = m_arena->create<abstractHWOpcode>(*I, stateName,m_arena,m_config,TD); //JAWAD
+                m_ops.push_back(op);
+            }
+            return;
+        }
+
+        // The priority needs the length of each opcode, so lower the block
+        // first and order the opcodes afterwards.
+        instructionPriority prioritizer(m_blocks);
+        InstructionVector insts;
+        for (unsigned int b = 0; b < m_blocks.size(); ++b) {
+            for (BasicBlock::iterator I = m_blocks[b]->begin(), E = m_blocks[b]->end(); I != E; ++I) {
+                insts.push_back(I);
+            }
+        }
+
+        // The side exits of a superblock: the branch waits for the
+        // instructions of its block and the instructions with side effects
+        // of the next block wait for the branch. A load may not pass a store
+        // of an earlier block.
+        vector<pair<Instruction*, Instruction*> > exitDeps;
+        vector<pair<Instruction*, Instruction*> > specDeps;
+        bool writesMemory = false;
+        for (unsigned int b = 0; b+1 < m_blocks.size(); ++b) {
+            Instruction* exit = m_blocks[b]->getTerminator();
+            for (BasicBlock::iterator I = m_blocks[b]->begin(); &*I != exit; ++I) {
+                writesMemory |= I->mayWriteToMemory();
+                exitDeps.push_back(std::make_pair(exit, &*I));
+                prioritizer.addDependency(exit, I);
+            }
+            for (BasicBlock::iterator I = m_blocks[b+1]->begin(), E = m_blocks[b+1]->end(); I != E; ++I) {
+                if (isSpeculable(I, m_config) && !(writesMemory && isa<LoadInst>(I))) continue;
+                specDeps.push_back(std::make_pair(&*I, exit));
+                prioritizer.addDependency(I, exit);
+            }
+        }
+
+        map<Instruction*, abstractHWOpcode*> opcodes;
+        instructionPriority::InstPriorityMap lengths;
+        for (InstructionVector::iterator I = insts.begin(), E = insts.end(); I != E; ++I) {
+            abstractHWOpcode *op = m_arena->create<abstractHWOpcode>(*I, stateName,m_arena,m_config,TD); //JAWAD
+            opcodes[*I] = op;
+            lengths[*I] = op->getLength();
+        }
+
+        InstructionVector order;
+        {
+            phaseTimer timer("lower/priority");
+            order = prioritizer.getCriticalPathOrder(lengths);
+        }
         for (InstructionVector::iterator I = order.begin(), E = order.end(); I != E; ++I) {
-            abstractHWOpcode *op = new abstractHWOpcode(*I, toPrintable(BB->getName()),2,TD); //JAWAD
-            m_ops.push_back(op);
+            m_ops.push_back(opcodes[*I]);
+        }
+
+        for (unsigned int b = 0; b+1 < m_blocks.size(); ++b) {
+            m_sideExits.push_back(opcodes[m_blocks[b]->getTerminator()]);
+        }
+        for (unsigned int i = 0; i < exitDeps.size(); ++i) {
+            m_exitDependencies.push_back(std::make_pair(
+                        opcodes[exitDeps[i].first], opcodes[exitDeps[i].second]));
+        }
+        for (unsigned int i = 0; i < specDeps.size(); ++i) {
+            m_speculationDependencies.push_back(std::make_pair(
+                        opcodes[specDeps[i].first], opcodes[specDeps[i].second]));
+        }
+    }
+
+    void listScheduler::scheduleBasicBlock(const schedulingEngine& engine) {
+        {
+            phaseTimer timer("schedule/dependencies");
+            computeDependencies();
+        }
+
+        // populate the opcoded in the scheduling table
+        phaseTimer timer("schedule/placement");
+        engine.schedule(this);
+    }//method
+
+    void listScheduler::computeDependencies() {
+        if (m_hasDependencies) return;
+        m_hasDependencies = true;
+
+        // maps each instruction to the previously generated opcode holding it
+        OpcodeOwnerMap owners;
+        // the opcodes which were created before the current one
+        vector<abstractHWOpcode*> previous;
+        previous.reserve(m_ops.size());
+
+        for (vector<abstractHWOpcode*>::iterator op = m_ops.begin(); op!= m_ops.end(); ++op) {
             // establish dependencies with previously generated opcodes
-            for (vector<abstractHWOpcode*>::iterator depop = m_ops.begin(); depop!= m_ops.end(); ++depop) {
-                op->addDependencyIfDepends(*depop);
+            (*op)->addDependencies(owners, previous);
+            (*op)->registerInstructions(owners);
+            previous.push_back(*op);
+        }
+
+        // the order of the blocks of a superblock
+        for (unsigned int i = 0; i < m_sideExits.size(); ++i) {
+            m_sideExits[i]->setSideExit();
+        }
+        for (unsigned int i = 0; i < m_exitDependencies.size(); ++i) {
+            m_exitDependencies[i].first->addDependencyOnLastCycle(m_exitDependencies[i].second);
+        }
+        for (unsigned int i = 0; i < m_speculationDependencies.size(); ++i) {
+            m_speculationDependencies[i].first->addDependency(m_speculationDependencies[i].second);
+        }
+
+        for (vector<abstractHWOpcode*>::iterator op = m_ops.begin(); op!= m_ops.end(); ++op) {
+            NumDependencies += (*op)->getDependencies().size();
+        }
+    }//method
+
+    void listScheduler::placeOnBestUnit(unsigned int opIndex, unsigned int earliest) {
+        vector<abstractHWOpcode*>::iterator depop = m_ops.begin() + opIndex;
+        vector<resourceUnit*> availableUnits;
+        resourceUnit* best_unit = NULL;
+        unsigned int best_loc = ~0U;
+        bool tracing = scheduleTrace::isEnabled();
+        placementDecision decision;
+        // for each resource unit 
+        for (vector<resourceUnit*>::iterator un = m_units.begin(); un!=m_units.end();++un) {
+            // if this is the correct type of unit
+            if ((*un)->isSameUnitType(*depop)) {
+                ++NumPlacementProbes;
+                unsigned int res = (*un)->getBestSchedulingCycle(*depop, earliest);
+                if (tracing) decision.candidates.push_back(std::make_pair(un - m_units.begin(), res));
+                if (res < best_loc) {
+                    best_loc = res;
+                    availableUnits.clear(); 
+                    availableUnits.push_back(*un);
+                } else if (res == best_loc) {
+                    availableUnits.push_back(*un);
+                }
+            } // if matches
+        }// foreach unit
+
+        // find the resourceUnit which has the least scheduled instructions
+        // we do this to create muxes which are balanced.
+        best_unit = resourceUnit::getLeastBusyResource(availableUnits);
+
+        // After finding the best resource unit, schedule this opcode there
+        assert(best_unit && "Unable to find best unit to schedule the opcode");
+        unsigned int unitIndex = std::find(m_units.begin(), m_units.end(), best_unit) - m_units.begin();
+        if ((*depop)->isMustBeLastOpcode()) {
+            //cerr<<"placing at "<<length()-1<<" or "<<best_loc<<" inside:\n "<<best_unit->toString()<<"\n";
+            unsigned int cur_max_len = ((length()>0) ? length()-1 : 0) ;
+            placeOpcode(opIndex, unitIndex, std::max(cur_max_len, best_loc));
+        } else {
+            // place this abstractHWOpcode in the right cycles
+            placeOpcode(opIndex, unitIndex, best_loc);
+        }
+
+        if (tracing) {
+            for (vector<resourceUnit*>::iterator un = availableUnits.begin(); un!=availableUnits.end();++un) {
+                unsigned int index = std::find(m_units.begin(), m_units.end(), *un) - m_units.begin();
+                decision.ties.push_back(std::make_pair(index, (*un)->takenSlots()));
             }
+            // placeOpcode recorded where the opcode went
+            PlacementDecisionList::reverse_iterator last = m_decisions.rbegin();
+            last->earliest = earliest;
+            last->searched = true;
+            last->candidates.swap(decision.candidates);
+            last->ties.swap(decision.ties);
         }
+    }//method
 
+    void listScheduler::placeOpcode(unsigned int op, unsigned int unit, unsigned int cycle) {
+        if (scheduleTrace::isEnabled()) {
+            placementDecision decision;
+            decision.op = op;
+            decision.ready = m_ops[op]->getFirstSchedulableSlot();
+            decision.earliest = 0;
+            decision.unit = unit;
+            decision.cycle = cycle;
+            decision.searched = false;
+            m_decisions.push_back(decision);
+        }
+        m_units[unit]->place(m_ops[op], cycle);
+        m_length = std::max(m_length, m_units[unit]->length());
+        m_version++;
+        if (m_opUnits.size() < m_ops.size()) m_opUnits.resize(m_ops.size());
+        m_opUnits[op] = unit;
+    }
 
-        // populate the opcoded in the scheduling table
-        // This is the actual scheduling of the abstract opcodes
-        // For each vector, place it in best location
-        for (vector<abstractHWOpcode*>::iterator depop = m_ops.begin(); depop!= m_ops.end(); ++depop) {
-            vector<resourceUnit*> availableUnits;
-            resourceUnit* best_unit = NULL;
-            unsigned int best_loc = 10000;
-            // for each resource unit 
-            for (vector<resourceUnit*>::iterator un = m_units.begin(); un!=m_units.end();++un) {
-                // if this is the correct type of unit
-                if ((*un)->isSameUnitType(*depop)) {
-                    unsigned int res = (*un)->getBestSchedulingCycle(*depop);
-                    if (res < best_loc) {
-                        best_loc = res;
-                        availableUnits.clear(); 
-                        availableUnits.push_back(*un);
-                    } else if (res == best_loc) {
-                        availableUnits.push_back(*un);
-                    }
-                } // if matches
-            }// foreach unit
-
-            // find the resourceUnit which has the least scheduled instructions
-            // we do this to create muxes which are balanced.
-            best_unit = resourceUnit::getLeastBusyResource(availableUnits);
-
-            // After finding the best resource unit, schedule this opcode there
-            assert(best_unit && "Unable to find best unit to schedule the opcode");
-            if ((*depop)->isMustBeLastOpcode()) {
-                //cerr<<"placing at "<<length()-1<<" or "<<best_loc<<" inside:\n "<<best_unit->toString()<<"\n";
-                unsigned int cur_max_len = ((length()>0) ? length()-1 : 0) ;
-                best_unit->place(*depop, std::max(cur_max_len, best_loc));
-            } else {
-                // place this abstractHWOpcode in the right cycles
-                best_unit->place(*depop, best_loc);
+    bool listScheduler::replaySchedule(const SchedulePlacement& placement) {
+        if (placement.size() != m_ops.size()) return false;
+        for (unsigned int i = 0; i < m_ops.size(); ++i) {
+            const opcodePlacement &p = placement[i];
+            if (p.unit >= m_units.size()) return false;
+            if (p.unitName != m_units[p.unit]->getName()) return false;
+            if (!m_units[p.unit]->isSameUnitType(m_ops[i])) return false;
+        }
+
+        // An opcode only depends on the opcodes before it, so placing them in
+        // order lets each one check its dependencies and the slots it takes.
+        computeDependencies();
+        for (unsigned int i = 0; i < m_ops.size(); ++i) {
+            abstractHWOpcode* op = m_ops[i];
+            unsigned int cycle = placement[i].cycle;
+            resourceUnit* unit = m_units[placement[i].unit];
+            bool valid = cycle >= op->getFirstSchedulableSlot() &&
+                unit->getBestSchedulingCycle(op, cycle) == cycle;
+            if (op->isMustBeLastOpcode() && cycle + 1 < length()) valid = false;
+            if (!valid) {
+                // the schedule is not for these opcodes, throw it away
+                resetSchedule();
+                return false;
             }
-        }// for each opcode 
+            placeOpcode(i, placement[i].unit, cycle);
+        }
+        return true;
+    }
+
+    SchedulePlacement listScheduler::getSchedulePlacement() {
+        SchedulePlacement placement;
+        for (unsigned int i = 0; i < m_ops.size(); ++i) {
+            assert(i < m_opUnits.size() && "opcode was not scheduled");
+            opcodePlacement p;
+            p.unit = m_opUnits[i];
+            p.unitName = m_units[p.unit]->getName();
+            p.cycle = m_ops[i]->getPlace();
+            placement.push_back(p);
+        }
+        return placement;
+    }
 
+    void listScheduler::dump() {
         //print list Scheduler
         // debug
         std::cerr<<"---=="<<this->getBB()->getName().str()<<"["<<this->length()<<"]==---\n";
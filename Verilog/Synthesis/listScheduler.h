@@ -11,7 +11,10 @@
 #include "llvm/Module.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/CFG.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/DataTypes.h"
 #include "llvm/DerivedTypes.h"
 
 #include <iostream>
@@ -24,6 +27,8 @@
 #include "../utils.h"
 #include "../params.h"
 #include "abstractHWOpcode.h"
+#include "instPriority.h"
+#include "reservationTable.h"
 
 
 
@@ -36,6 +41,17 @@ using std::map;
 
 namespace xVerilog {
 
+    /// The id of the resource unit and the first cycle an instruction is placed at
+    typedef std::pair<unsigned int, unsigned int> PlacementInfo;
+    /// Placement of every scheduled instruction of a BasicBlock
+    typedef DenseMap<Instruction*, PlacementInfo> PlacementMap;
+
+    class schedulingEngine;
+
+    /// the PHINodes of a pipelined loop and the cycle in which each one is
+    /// copied from the value of the next iteration
+    typedef vector<std::pair<PHINode*, unsigned int> > PhiCopyList;
+
     /*
      * Represents a hardware execution unit (such as an instance of an ALU
      *  on a processor)
@@ -44,13 +60,16 @@ namespace xVerilog {
         public:
             /*
              * C'tor
+             * @param placements if not NULL, every instruction placed on this
+             *  unit is recorded there with the unit id and cycle
              */
-            resourceUnit(string name, unsigned int id, unsigned int streamNum = 2);
+            resourceUnit(string name, unsigned int id, unsigned int streamNum = 2,
+                    PlacementMap* placements = NULL);
 
             /*
              * @return the length of this resource unit in cycles which are scheduled
              */
-            unsigned int length();
+            unsigned int length() {return m_length;}
 
             /*
              * @return True if instruction inst is scheduled to run in this 
@@ -73,11 +92,19 @@ namespace xVerilog {
              * @return id of unit
              */
             unsigned int getId() {return m_id;}
+            /*
+             * @return the number of streams of this unit
+             */
+            unsigned int getNumberOfStreams() {return m_tables.size();}
+            /*
+             * @return the taken cycles and the instructions of stream 'streamID'
+             */
+            const reservationTable& getStream(unsigned int streamID) {return m_tables[streamID];}
             /*
              * @return the best possible possition to schedule 'op' in this
-             *  instruction unit.
+             *  instruction unit, not before cycle 'earliest'.
              */
-            unsigned int getBestSchedulingCycle(abstractHWOpcode* op);
+            unsigned int getBestSchedulingCycle(abstractHWOpcode* op, unsigned int earliest = 0);
             /*
              * Place the abstract opcode in possition 'place'
              */
@@ -90,7 +117,7 @@ namespace xVerilog {
             /** 
              * @return returns the number of cycles which are already assigned
              */
-            unsigned int takenSlots();
+            unsigned int takenSlots() {return m_taken;}
 
             /** 
              * @brief select the resource with the fewest number of resources scheduled to it. 
@@ -103,41 +130,97 @@ namespace xVerilog {
              */
             static resourceUnit* getLeastBusyResource(vector<resourceUnit*> availableResources);
         private:
-
-            /** 
-             * @brief Enlarge the resource table by 'count' cycles to make room
-             * for scheduling of more instructions. 
-             * 
-             * @param newSize the new size of the table
-             */
-            void enlargeResourceTable(unsigned int newSize);
-
-            /** 
-             * @return are there any uOp instructions on a stream in a cycle
-             */
-            bool emptyAt(unsigned int streamID, unsigned int cycle);
-            /*
-             * @return the length of this resource unit in cycles which are scheduled
-             * @param the stream who's length we want
-             */
-            unsigned int length(unsigned int streamID);
-
-            /** 
-             * @return the best possible possition to schedule 'op' in the 
-             * given seq (seq_in or seq_out)
-             */
-            static unsigned int getBestSchedulingCycle(abstractHWOpcode* op, InstructionSequence &seq);
-
             /// name of hardware unit
             string m_name;
             /// the id of this unit, used for placing opcodes
             unsigned int m_id;
-            /// storage for the instructions
-            vector<InstructionSequence> m_seq;
+            /// the taken cycles and the instructions of each stream
+            vector<reservationTable> m_tables;
+            /// where to record the placement of instructions, may be NULL
+            PlacementMap* m_placements;
+            /// the longest stream and the taken cycles of all of the streams,
+            /// kept up to date by place()
+            unsigned int m_length;
+            unsigned int m_taken;
     };
 
     typedef map<std::string, unsigned int> MemportMap;
 
+    /*
+     * Where a single opcode was placed: the index of the resource unit in
+     *  the scheduler, the name of the unit and the first cycle.
+     */
+    struct opcodePlacement {
+        unsigned int unit;
+        string unitName;
+        unsigned int cycle;
+    };
+    /// the placement of all of the opcodes of a block, in opcode order
+    typedef vector<opcodePlacement> SchedulePlacement;
+
+    /*
+     * Why an opcode was placed where it is, for the scheduling trace. The
+     *  units are indices into the units of the scheduler.
+     */
+    struct placementDecision {
+        /// the index of the opcode
+        unsigned int op;
+        /// the first cycle after the dependencies of the opcode are done
+        unsigned int ready;
+        /// the earliest cycle the engine asked for
+        unsigned int earliest;
+        /// the unit and the cycle the opcode was placed at
+        unsigned int unit;
+        unsigned int cycle;
+        /// false if an engine placed the opcode directly, without a search
+        bool searched;
+        /// each unit of the right type and its best scheduling cycle
+        vector<pair<unsigned int, unsigned int> > candidates;
+        /// the units which tied on the best cycle and their taken slots
+        vector<pair<unsigned int, unsigned int> > ties;
+    };
+    /// the decisions of a block, in the order they were made
+    typedef vector<placementDecision> PlacementDecisionList;
+
+    /*
+     * The instructions of a scheduled block grouped by cycle, each with the
+     *  id of its resource unit. All of the cycles share one array: cycle i
+     *  is [begin(i), end(i)), in the order of getInstructionForCycle. The
+     *  emitters and the scorer walk it without allocating. Built by
+     *  listScheduler::getScheduleView.
+     */
+    class scheduleView {
+        public:
+            /// an instruction and the id of the unit it runs on
+            struct entry {
+                Instruction* inst;
+                unsigned int unit;
+            };
+            typedef vector<entry>::const_iterator iterator;
+
+            scheduleView():m_valid(false),m_version(0) {}
+
+            /*
+             * @return the number of cycles of the block
+             */
+            unsigned int getNumberOfCycles() const {return m_offsets.empty() ? 0 : m_offsets.size() - 1;}
+            /*
+             * @return the instructions of 'cycle'
+             */
+            iterator begin(unsigned int cycle) const {return m_entries.begin() + m_offsets[cycle];}
+            iterator end(unsigned int cycle) const {return m_entries.begin() + m_offsets[cycle+1];}
+
+        private:
+            friend class listScheduler;
+            /// the instructions of all of the cycles, cycle by cycle
+            vector<entry> m_entries;
+            /// where each cycle starts in m_entries, and the end of the last one
+            vector<unsigned int> m_offsets;
+            /// was it built, and for which version of the schedule
+            bool m_valid;
+            unsigned int m_version;
+    };
+
     /*
      *The class which schedules the hardware opcodes in their 
      * different locations. This class is the main entry point for the
@@ -147,17 +230,150 @@ namespace xVerilog {
         public:
             /*
              *C'tor list scheduler
+             * Populates the scheduler data structure with micro-commands. 
+             *  This may destroy the BasicBlock. (It will replace well formed
+             *  instructions with meaningless loads and stores to virtual
+             *  registers.) It also creates global variables, so schedulers 
+             *  must be constructed one at a time. 
+             * @param arena owns the units and opcodes created by this scheduler
+             * @param config the execution units of the machine
+             * @param priority the order in which the opcodes are scheduled
+             */
+            listScheduler(BasicBlock* BB,TargetData* TD, schedulingArena* arena,
+                    const resourceConfig& config,
+                    priorityKind priority = CriticalPathPriority); //JAWAD
+            /*
+             *C'tor list scheduler of a superblock
+             * Schedules the blocks of a trace as one block, whose states are
+             *  named after the first block. Each block must be the only
+             *  predecessor of the next one. The branches of the blocks but the
+             *  last are side exits: the operations of the block are done when
+             *  the side exit is taken, and only the operations of the next
+             *  blocks which have no side effects may start before it. A trace
+             *  is always ordered by its critical path.
              */
-            listScheduler(BasicBlock* BB,TargetData* TD); //JAWAD
+            listScheduler(const vector<BasicBlock*>& blocks,TargetData* TD, schedulingArena* arena,
+                    const resourceConfig& config, priorityKind priority = CriticalPathPriority);
             /*
-             * @return the BasicBlock that we are scheduling
+             * @return the BasicBlock that we are scheduling, the head of a
+             *  superblock
              *
              */
             BasicBlock* getBB() {return m_bb;}
+            /*
+             * @return the blocks that we are scheduling, one unless this is a
+             *  superblock
+             */
+            const vector<BasicBlock*>& getBlocks() {return m_blocks;}
+            /*
+             * @return the block after BB in the superblock, NULL if BB is
+             *  the last one
+             */
+            BasicBlock* getTraceSuccessor(BasicBlock* BB);
+            /*
+             * Find the dependencies between the opcodes and let 'engine' place
+             *  them in the scheduling table. This only reads the IR, so different
+             *  blocks may be scheduled on different threads at the same time.
+             */
+            void scheduleBasicBlock(const schedulingEngine& engine);
+            /*
+             * Find the dependencies between the opcodes, once. Only reads the IR.
+             */
+            void computeDependencies();
+            /*
+             * @return the opcodes of the block, in priority order. An opcode
+             *  only depends on opcodes which come before it.
+             */
+            vector<abstractHWOpcode*>& getOpcodes() {return m_ops;}
+            /*
+             * Place opcode number 'op' on the unit which can start it first, not
+             *  before cycle 'earliest' and not before its dependencies are done.
+             *  Ties go to the least busy unit. Opcodes which must be last are
+             *  not placed before the last cycle of the table.
+             */
+            void placeOnBestUnit(unsigned int op, unsigned int earliest = 0);
+            /*
+             * Place opcode number 'op' on unit number 'unit' at 'cycle'
+             */
+            void placeOpcode(unsigned int op, unsigned int unit, unsigned int cycle);
+            /*
+             * @return the resource units of the block
+             */
+            vector<resourceUnit*>& getUnits() {return m_units;}
+            /*
+             * Remove all of the opcodes from the scheduling table, so the
+             *  block can be scheduled again.
+             */
+            void resetSchedule();
+            /*
+             * Remember the length of the schedule the heuristic engine found,
+             *  before a better engine replaced it.
+             */
+            void setHeuristicLength(unsigned int len) {m_heuristicLength = len;}
+            /*
+             * @return the length of the heuristic schedule of this block. This
+             *  is length() unless the exact scheduler improved the block.
+             */
+            unsigned int getHeuristicLength();
+            /*
+             * Declare this block a pipelined loop: a new iteration starts every
+             *  'ii' cycles and the table holds the schedule of one iteration,
+             *  which is 'stages' kernel passes long.
+             * @param copies when each PHINode of the loop takes the value of
+             *  the next iteration
+             */
+            void setModuloSchedule(unsigned int ii, unsigned int stages, const PhiCopyList& copies);
+            /*
+             * @return the initiation interval, zero if the block is not pipelined
+             */
+            unsigned int getInitiationInterval() {return m_ii;}
+            /*
+             * @return the number of kernel passes of one iteration of a pipelined loop
+             */
+            unsigned int getNumberOfStages() {return m_stages;}
+            /*
+             * @return the PHINode copies of a pipelined loop
+             */
+            const PhiCopyList& getPhiCopies() {return m_phiCopies;}
+            /*
+             * @return the number of FSM states of this block. This is the
+             *  initiation interval for a pipelined loop and length() otherwise.
+             */
+            unsigned int getStateCount() {return m_ii ? m_ii : length();}
+            /*
+             * Place the opcodes exactly where a previous run of scheduleBasicBlock
+             *  on the same block placed them (see getSchedulePlacement). Each
+             *  opcode is checked as it is placed: it must not start before its
+             *  dependencies are done, nor collide with the opcodes placed before
+             *  it, and an opcode which must be last must be last.
+             * @return false, with an empty schedule, if the placement does not
+             *  match the opcodes and units of this block or breaks a check
+             */
+            bool replaySchedule(const SchedulePlacement& placement);
+            /*
+             * @return the placement of each of the opcodes, after scheduling
+             */
+            SchedulePlacement getSchedulePlacement();
+            /*
+             * @return why each opcode was placed where it is. Only recorded
+             *  when the scheduling trace is on (see scheduleTrace).
+             */
+            const PlacementDecisionList& getPlacementDecisions() {return m_decisions;}
+            /*
+             * Print the first cycles of the scheduling table to stderr, for
+             *  use from a debugger
+             */
+            void dump();
             /*
              * @return vector<Instruction*> instructions for a given cycle.
              */
             vector<Instruction*> getInstructionForCycle(unsigned int cycleNum);
+            /*
+             * @return the instructions of every cycle. It is built on the
+             *  first call after the schedule changed, and stays valid until
+             *  the next change.
+             */
+            const scheduleView& getScheduleView();
             /*
              * @return vector<assignPartEntry*> all assign parts of this basic block
              */
@@ -165,12 +381,22 @@ namespace xVerilog {
             /*
              * @returns the num of cycles for this BasicBlock schedule
              */
-            unsigned int length();
+            unsigned int length() {return m_length;}
+            /*
+             * @return a number which changes whenever an opcode is placed or
+             *  the schedule is reset. Views built from the schedule are valid
+             *  while it stays the same.
+             */
+            unsigned int getScheduleVersion() {return m_version;}
             /*
              * @return the id of the resourceUnit which instruction inst is
              *  scheduled in
              */
             unsigned int getResourceIdForInstruction(Instruction* inst);
+            /*
+             * @return the first cycle in which instruction inst is scheduled
+             */
+            unsigned int getCycleForInstruction(Instruction* inst);
 
             /** 
              * @brief Returns a list of memory port names and their decleration types
@@ -189,12 +415,14 @@ namespace xVerilog {
             void addResource(string name, unsigned int count);
 
             /*
-             * Populate the scheduler data structure with micro-commands
-             *  this may destroy the BasicBlock. (It will replace well formed
-             *  instructions with meaningless loads and stores to virtual
-             *  registers.)
+             * Create the abstract opcodes of the blocks, in priority order
+             */
+            void lowerBlocks(priorityKind priority);
+
+            /*
+             * Create the resource units, with empty tables
              */
-            void scheduleBasicBlock(BasicBlock* BB);
+            void createUnits();
 
             /** 
              * 
@@ -211,8 +439,41 @@ namespace xVerilog {
             vector<resourceUnit*> m_units;
             /// name of BasicBlock in printable form
             BasicBlock* m_bb;
+            /// the blocks of a superblock, m_bb first
+            vector<BasicBlock*> m_blocks;
+            /// the branch opcodes of a superblock which are side exits
+            vector<abstractHWOpcode*> m_sideExits;
+            /// a side exit and an opcode of its block, which is done when the
+            /// side exit is taken
+            vector<pair<abstractHWOpcode*, abstractHWOpcode*> > m_exitDependencies;
+            /// an opcode with side effects and the side exit it waits for
+            vector<pair<abstractHWOpcode*, abstractHWOpcode*> > m_speculationDependencies;
             /// lists all of the abstractHWOpcodes which were scheduled
             vector<abstractHWOpcode*> m_ops;
+            /// the index in m_units of the unit of each opcode in m_ops
+            vector<unsigned int> m_opUnits;
+            /// the placement decisions, if the scheduling trace is on
+            PlacementDecisionList m_decisions;
+            /// owner of the units and opcodes
+            schedulingArena* m_arena;
+            /// the execution units of the machine
+            const resourceConfig& m_config;
+            /// the unit id and cycle of each instruction placed in m_units
+            PlacementMap m_placements;
+            /// the length of the longest unit, kept up to date by placeOpcode
+            unsigned int m_length;
+            /// see getScheduleVersion
+            unsigned int m_version;
+            /// see getScheduleView
+            scheduleView m_view;
+            /// the length of the heuristic schedule, zero if it was not replaced
+            unsigned int m_heuristicLength;
+            /// were the dependencies of the opcodes calculated
+            bool m_hasDependencies;
+            /// the modulo schedule of a pipelined loop, m_ii is zero if not pipelined
+            unsigned int m_ii;
+            unsigned int m_stages;
+            PhiCopyList m_phiCopies;
             /// A list of all memory ports and their bitwidth
             MemportMap m_memoryPorts; 
     }; //class
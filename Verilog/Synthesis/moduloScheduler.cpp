@@ -0,0 +1,513 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "moduloScheduler.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+namespace xVerilog {
+
+    /// loops with more opcodes are not pipelined
+    static const unsigned int MaxModuloOps = 256;
+    /// the number of placements per opcode before an II is given up
+    static const unsigned int BudgetRatio = 6;
+    /// the number of wires followed when looking for a producer
+    static const unsigned int MaxWireDepth = 8;
+
+    moduloScheduler::moduloScheduler(listScheduler* ls):
+        m_ls(ls),m_branch(0),m_resMII(1),m_recMII(1) {}
+
+    bool moduloScheduler::isSingleBlockLoop(BasicBlock* BB) {
+        BranchInst* br = dyn_cast<BranchInst>(BB->getTerminator());
+        if (!br || !br->isConditional()) return false;
+        // exactly one of the successors is the loop itself
+        return ((br->getSuccessor(0) == BB) != (br->getSuccessor(1) == BB));
+    }
+
+    void moduloScheduler::addEdge(unsigned int from, unsigned int to, int latency, unsigned int distance) {
+        moduloEdge e;
+        e.from = from;
+        e.to = to;
+        e.latency = latency;
+        e.distance = distance;
+        m_in[to].push_back(m_edges.size());
+        m_out[from].push_back(m_edges.size());
+        m_edges.push_back(e);
+    }
+
+    void moduloScheduler::getProducers(Value* val, vector<unsigned int>& producers, unsigned int depth) {
+        Instruction* inst = dyn_cast<Instruction>(val);
+        if (!inst) return;
+
+        OpcodeOwnerMap::iterator it = m_owners.find(inst);
+        if (it != m_owners.end()) {
+            unsigned int p = m_index[it->second];
+            if (std::find(producers.begin(), producers.end(), p) == producers.end()) {
+                producers.push_back(p);
+            }
+            return;
+        }
+
+        // the lowering leaves wires, which are not in the block, between opcodes
+        if (inst->getParent() || depth >= MaxWireDepth) return;
+        for (User::op_iterator op = inst->op_begin(); op != inst->op_end(); ++op) {
+            getProducers(*op, producers, depth+1);
+        }
+    }
+
+    bool moduloScheduler::buildGraph() {
+        m_ls->computeDependencies();
+        m_ops = m_ls->getOpcodes();
+        vector<resourceUnit*>& units = m_ls->getUnits();
+        BasicBlock* BB = m_ls->getBB();
+        unsigned int n = m_ops.size();
+        if (0 == n || n > MaxModuloOps) return false;
+
+        m_len.assign(n, 0);
+        m_extent.assign(n, 0);
+        m_mask.assign(n, vector<vector<unsigned int> >());
+        m_units.assign(n, vector<unsigned int>());
+        m_store.assign(n, 0);
+        m_liveOut.assign(n, 0);
+        m_in.assign(n, vector<unsigned int>());
+        m_out.assign(n, vector<unsigned int>());
+        m_edges.clear();
+        m_phis.clear();
+
+        m_shared.resize(units.size());
+        for (unsigned int u = 0; u < units.size(); ++u) {
+            m_shared[u] = (units[u]->getName() == "other");
+        }
+
+        for (unsigned int i = 0; i < n; ++i) {
+            m_ops[i]->registerInstructions(m_owners);
+            m_index[m_ops[i]] = i;
+        }
+
+        m_branch = n;
+        for (unsigned int i = 0; i < n; ++i) {
+            abstractHWOpcode* op = m_ops[i];
+            m_len[i] = op->getLength();
+
+            if (op->isMustBeLastOpcode()) {
+                if (m_branch != n) return false;
+                m_branch = i;
+            }
+
+            m_mask[i].resize(op->getNumberOfStreams());
+            for (unsigned int st = 0; st < m_mask[i].size(); ++st) {
+                for (unsigned int c = 0; c < m_len[i]; ++c) {
+                    if (op->emptyAt(st, c)) continue;
+                    m_mask[i][st].push_back(c);
+                    m_extent[i] = std::max(m_extent[i], c+1);
+                }
+            }
+
+            for (unsigned int u = 0; u < units.size(); ++u) {
+                if (units[u]->isSameUnitType(op)) m_units[i].push_back(u);
+            }
+            if (m_units[i].empty()) return false;
+
+            bool hasLoad = false;
+            bool hasStore = false;
+            for (unsigned int st = 0; st < op->getNumberOfStreams(); ++st) {
+                for (unsigned int c = 0; c < op->getLength(st); ++c) {
+                    InstructionCycle cycle = op->cycleAt(st, c);
+                    for (InstructionCycle::iterator I = cycle.begin(); I != cycle.end(); ++I) {
+                        if (isa<ReturnInst>(*I)) return false;
+                        if (isa<LoadInst>(*I)) hasLoad = true;
+                        if (isa<StoreInst>(*I)) hasStore = true;
+
+                        for (Value::use_iterator U = (*I)->use_begin(); U != (*I)->use_end(); ++U) {
+                            Instruction* user = dyn_cast<Instruction>(*U);
+                            if (user && user->getParent() && user->getParent() != BB) m_liveOut[i] = true;
+                        }
+                    }
+                }
+            }
+            m_store[i] = (hasStore && !hasLoad);
+
+            const set<abstractHWOpcode*>& deps = op->getDependencies();
+            for (set<abstractHWOpcode*>::const_iterator it = deps.begin(); it != deps.end(); ++it) {
+                unsigned int p = m_index[*it];
+                addEdge(p, i, m_len[p], 0);
+            }
+        }
+        if (m_branch == n) return false;
+
+        // the branch comes last
+        for (unsigned int i = 0; i < n; ++i) {
+            if (i != m_branch && m_extent[i] > 0) addEdge(i, m_branch, m_extent[i]-1, 0);
+        }
+
+        // the values which the PHINodes take from the previous iteration
+        vector<char> isPhiOp(n, 0);
+        for (BasicBlock::iterator I = BB->begin(); I != BB->end(); ++I) {
+            PHINode* phi = dyn_cast<PHINode>(I);
+            if (!phi) break;
+            OpcodeOwnerMap::iterator owner = m_owners.find(phi);
+            if (owner == m_owners.end()) return false;
+
+            loopPhi lp;
+            lp.phi = phi;
+            lp.op = m_index[owner->second];
+            getProducers(phi->getIncomingValueForBlock(BB), lp.producers);
+            isPhiOp[lp.op] = true;
+            m_phis.push_back(lp);
+        }
+
+        for (unsigned int k = 0; k < m_phis.size(); ++k) {
+            const loopPhi& lp = m_phis[k];
+            for (unsigned int j = 0; j < lp.producers.size(); ++j) {
+                unsigned int p = lp.producers[j];
+                // a PHINode which takes the value of another PHINode
+                if (isPhiOp[p]) return false;
+
+                // the copy is one cycle after the producer is done, and the
+                // readers of the PHINode in the next iteration come after it
+                vector<unsigned int> readers = m_out[lp.op];
+                for (unsigned int r = 0; r < readers.size(); ++r) {
+                    moduloEdge e = m_edges[readers[r]];
+                    if (0 != e.distance || e.to == m_branch) continue;
+                    addEdge(p, e.to, m_len[p] + 1, 1);
+                }
+            }
+        }
+
+        // the accesses to the same memory stay in order across iterations
+        for (unsigned int a = 0; a < n; ++a) {
+            if (0 != m_ops[a]->getName().find("mem_")) continue;
+            for (unsigned int b = 0; b < n; ++b) {
+                if (m_ops[a]->getName() != m_ops[b]->getName()) continue;
+                if (m_store[a] || (m_store[b] && a != b)) addEdge(a, b, m_len[a], 1);
+            }
+        }
+        return true;
+    }
+
+    bool moduloScheduler::hasPositiveCycle(unsigned int ii) {
+        // Bellman-Ford on the longest paths, from a source which reaches all
+        vector<long> dist(m_ops.size(), 0);
+        for (unsigned int pass = 0; pass <= m_ops.size(); ++pass) {
+            bool changed = false;
+            for (unsigned int k = 0; k < m_edges.size(); ++k) {
+                const moduloEdge& e = m_edges[k];
+                long d = dist[e.from] + e.latency - (long)ii * e.distance;
+                if (d > dist[e.to]) {
+                    dist[e.to] = d;
+                    changed = true;
+                }
+            }
+            if (!changed) return false;
+        }
+        return true;
+    }
+
+    void moduloScheduler::computeRecMII() {
+        unsigned int hi = 1;
+        for (unsigned int k = 0; k < m_edges.size(); ++k) {
+            hi += std::max(m_edges[k].latency, 0);
+        }
+        unsigned int lo = 1;
+        // the smallest II without a cycle which is longer than II
+        while (lo < hi) {
+            unsigned int mid = (lo + hi) / 2;
+            if (hasPositiveCycle(mid)) lo = mid + 1;
+            else hi = mid;
+        }
+        m_recMII = lo;
+    }
+
+    void moduloScheduler::computeResMII() {
+        // the number of taken cycles of each stream of each kind of unit
+        std::map<std::string, vector<unsigned int> > usage;
+        std::map<std::string, unsigned int> count;
+        for (unsigned int i = 0; i < m_ops.size(); ++i) {
+            if (m_shared[m_units[i][0]]) continue;
+            std::string kind = m_ops[i]->getName();
+            vector<unsigned int>& use = usage[kind];
+            use.resize(m_mask[i].size(), 0);
+            for (unsigned int st = 0; st < m_mask[i].size(); ++st) use[st] += m_mask[i][st].size();
+            count[kind] = m_units[i].size();
+        }
+
+        m_resMII = 1;
+        for (std::map<std::string, vector<unsigned int> >::iterator it = usage.begin();
+                it != usage.end(); ++it) {
+            unsigned int units = count[it->first];
+            for (unsigned int st = 0; st < it->second.size(); ++st) {
+                m_resMII = std::max(m_resMII, (it->second[st] + units - 1) / units);
+            }
+        }
+    }
+
+    bool moduloScheduler::fits(unsigned int i, unsigned int u, unsigned int t, unsigned int ii) {
+        if (m_shared[u]) return true;
+        for (unsigned int st = 0; st < m_mask[i].size(); ++st) {
+            for (unsigned int k = 0; k < m_mask[i][st].size(); ++k) {
+                if (m_mrt[u][st][(t + m_mask[i][st][k]) % ii] >= 0) return false;
+            }
+        }
+        return true;
+    }
+
+    void moduloScheduler::mark(unsigned int i, unsigned int u, unsigned int t, unsigned int ii, int owner) {
+        if (m_shared[u]) return;
+        for (unsigned int st = 0; st < m_mask[i].size(); ++st) {
+            for (unsigned int k = 0; k < m_mask[i][st].size(); ++k) {
+                m_mrt[u][st][(t + m_mask[i][st][k]) % ii] = owner;
+            }
+        }
+    }
+
+    void moduloScheduler::unschedule(unsigned int i, unsigned int ii) {
+        if (m_start[i] < 0) return;
+        mark(i, m_unit[i], m_start[i], ii, -1);
+        m_start[i] = -1;
+    }
+
+    bool moduloScheduler::scheduleWithII(unsigned int ii) {
+        unsigned int n = m_ops.size();
+
+        // an opcode may not collide with itself in the next iteration
+        for (unsigned int i = 0; i < n; ++i) {
+            if (m_shared[m_units[i][0]]) continue;
+            for (unsigned int st = 0; st < m_mask[i].size(); ++st) {
+                vector<char> slots(ii, 0);
+                for (unsigned int k = 0; k < m_mask[i][st].size(); ++k) {
+                    unsigned int slot = m_mask[i][st][k] % ii;
+                    if (slots[slot]) return false;
+                    slots[slot] = 1;
+                }
+            }
+        }
+
+        m_start.assign(n, -1);
+        m_unit.assign(n, 0);
+        vector<resourceUnit*>& units = m_ls->getUnits();
+        m_mrt.resize(units.size());
+        for (unsigned int u = 0; u < units.size(); ++u) {
+            m_mrt[u].assign(units[u]->getNumberOfStreams(), vector<int>(ii, -1));
+        }
+        vector<int> lastTry(n, -1);
+
+        // the priority is the height of the opcode, its distance to the end
+        vector<long> height(n, 0);
+        for (unsigned int i = 0; i < n; ++i) height[i] = m_extent[i];
+        for (unsigned int pass = 0; pass < n; ++pass) {
+            bool changed = false;
+            for (unsigned int k = 0; k < m_edges.size(); ++k) {
+                const moduloEdge& e = m_edges[k];
+                long h = height[e.to] + e.latency - (long)ii * e.distance;
+                if (h > height[e.from]) {
+                    height[e.from] = h;
+                    changed = true;
+                }
+            }
+            if (!changed) break;
+        }
+
+        unsigned int budget = BudgetRatio * n;
+        while (budget--) {
+            // the unscheduled opcode with the highest priority
+            int next = -1;
+            for (unsigned int i = 0; i < n; ++i) {
+                if (m_start[i] >= 0) continue;
+                if (next < 0 || height[i] > height[next]) next = i;
+            }
+            if (next < 0) return true;
+            unsigned int i = next;
+
+            // the earliest start allowed by the scheduled predecessors
+            long estart = 0;
+            for (unsigned int k = 0; k < m_in[i].size(); ++k) {
+                const moduloEdge& e = m_edges[m_in[i][k]];
+                if (e.from == i || m_start[e.from] < 0) continue;
+                estart = std::max(estart, m_start[e.from] + e.latency - (long)ii * e.distance);
+            }
+
+            int cycle = -1;
+            unsigned int unit = 0;
+            for (unsigned int t = estart; t < estart + ii && cycle < 0; ++t) {
+                for (unsigned int k = 0; k < m_units[i].size(); ++k) {
+                    if (fits(i, m_units[i][k], t, ii)) {
+                        cycle = t;
+                        unit = m_units[i][k];
+                        break;
+                    }
+                }
+            }
+
+            if (cycle < 0) {
+                // no free slot, force the opcode in and evict the ones in its way
+                cycle = (lastTry[i] < 0 || estart > lastTry[i]) ? estart : lastTry[i] + 1;
+                unit = m_units[i][cycle % m_units[i].size()];
+                if (!m_shared[unit]) {
+                    for (unsigned int st = 0; st < m_mask[i].size(); ++st) {
+                        for (unsigned int k = 0; k < m_mask[i][st].size(); ++k) {
+                            int owner = m_mrt[unit][st][(cycle + m_mask[i][st][k]) % ii];
+                            if (owner >= 0) unschedule(owner, ii);
+                        }
+                    }
+                }
+            }
+
+            m_start[i] = cycle;
+            m_unit[i] = unit;
+            lastTry[i] = cycle;
+            mark(i, unit, cycle, ii, i);
+
+            // evict the successors whose dependency is now broken
+            for (unsigned int k = 0; k < m_out[i].size(); ++k) {
+                const moduloEdge& e = m_edges[m_out[i][k]];
+                if (e.to == i || m_start[e.to] < 0) continue;
+                if (m_start[e.to] < cycle + e.latency - (long)ii * e.distance) unschedule(e.to, ii);
+            }
+        }
+
+        for (unsigned int i = 0; i < n; ++i) {
+            if (m_start[i] < 0) return false;
+        }
+        return true;
+    }
+
+    unsigned int moduloScheduler::getPhiCopyCycle(const loopPhi& phi, unsigned int ii) {
+        unsigned int copy = 0;
+        if (!phi.producers.empty()) {
+            // one cycle after the last of the producers is done
+            for (unsigned int k = 0; k < phi.producers.size(); ++k) {
+                unsigned int p = phi.producers[k];
+                copy = std::max(copy, m_start[p] + m_len[p]);
+            }
+            return copy;
+        }
+
+        // the next value is not computed in the loop, it is copied after the
+        // last read of the PHINode
+        for (unsigned int k = 0; k < m_out[phi.op].size(); ++k) {
+            const moduloEdge& e = m_edges[m_out[phi.op][k]];
+            if (0 != e.distance) continue;
+            copy = std::max(copy, m_start[e.to] + std::max(m_extent[e.to], 1U) - 1);
+        }
+        return copy;
+    }
+
+    unsigned int moduloScheduler::getIterationLength(unsigned int ii) {
+        unsigned int len = 0;
+        for (unsigned int i = 0; i < m_ops.size(); ++i) {
+            len = std::max(len, m_start[i] + m_extent[i]);
+        }
+        for (unsigned int k = 0; k < m_phis.size(); ++k) {
+            len = std::max(len, getPhiCopyCycle(m_phis[k], ii) + 1);
+        }
+        return len;
+    }
+
+    bool moduloScheduler::verify(unsigned int ii) {
+        unsigned int n = m_ops.size();
+        unsigned int len = getIterationLength(ii);
+        // without overlapping iterations there is nothing to gain
+        if ((len + ii - 1) / ii < 2) return false;
+
+        // The iterations which start before the branch of an iteration exits
+        // the loop must not write memory.
+        long exit = m_start[m_branch];
+        for (unsigned int i = 0; i < n; ++i) {
+            if (m_store[i] && m_start[i] + (long)ii <= exit) return false;
+        }
+
+        // [ready, expire) is the window in which the registers of each opcode
+        // hold the value of the iteration
+        const long never = (long)len * 4 + (long)ii * 4;
+        vector<long> ready(n, -never);
+        vector<long> expire(n, never);
+        vector<char> isPhiOp(n, 0);
+
+        for (unsigned int k = 0; k < m_phis.size(); ++k) {
+            unsigned int op = m_phis[k].op;
+            long copy = getPhiCopyCycle(m_phis[k], ii);
+            ready[op] = copy + 1 - ii;
+            expire[op] = copy + 1;
+            isPhiOp[op] = true;
+        }
+
+        for (unsigned int i = 0; i < n; ++i) {
+            if (isPhiOp[i]) continue;
+            abstractHWOpcode* op = m_ops[i];
+            const set<abstractHWOpcode*>& deps = op->getDependencies();
+
+            if (0 == m_len[i]) {
+                // a wire holds the values of its operands
+                for (set<abstractHWOpcode*>::const_iterator it = deps.begin(); it != deps.end(); ++it) {
+                    unsigned int p = m_index[*it];
+                    ready[i] = std::max(ready[i], ready[p]);
+                    expire[i] = std::min(expire[i], expire[p]);
+                }
+                continue;
+            }
+
+            ready[i] = m_start[i] + m_len[i];
+            expire[i] = ready[i] + ii;
+            for (set<abstractHWOpcode*>::const_iterator it = deps.begin(); it != deps.end(); ++it) {
+                expire[i] = std::min(expire[i], expire[m_index[*it]] + 1);
+            }
+
+            // the operands are read in the first cycle of an opcode with an
+            // assign part, and all along the other opcodes
+            long readEnd = m_start[i] + (op->getAssignPart() ? 1 : std::max(m_extent[i], 1U));
+            for (set<abstractHWOpcode*>::const_iterator it = deps.begin(); it != deps.end(); ++it) {
+                unsigned int p = m_index[*it];
+                if (m_start[i] < ready[p] || readEnd > expire[p]) return false;
+            }
+        }
+
+        // the PHINode copies read the producers
+        for (unsigned int k = 0; k < m_phis.size(); ++k) {
+            long copy = getPhiCopyCycle(m_phis[k], ii);
+            for (unsigned int j = 0; j < m_phis[k].producers.size(); ++j) {
+                if (copy >= expire[m_phis[k].producers[j]]) return false;
+            }
+        }
+
+        // the values used after the loop must survive the exit
+        for (unsigned int i = 0; i < n; ++i) {
+            if (m_liveOut[i] && expire[i] <= exit + 1) return false;
+        }
+        return true;
+    }
+
+    void moduloScheduler::apply(unsigned int ii) {
+        unsigned int len = getIterationLength(ii);
+        PhiCopyList copies;
+        for (unsigned int k = 0; k < m_phis.size(); ++k) {
+            copies.push_back(std::make_pair(m_phis[k].phi, getPhiCopyCycle(m_phis[k], ii)));
+        }
+
+        // keep the length of the list schedule for the report
+        m_ls->setHeuristicLength(m_ls->getHeuristicLength());
+        m_ls->resetSchedule();
+        for (unsigned int i = 0; i < m_ops.size(); ++i) {
+            m_ops[i]->setInitiationInterval(ii);
+            m_ls->placeOpcode(i, m_unit[i], m_start[i]);
+        }
+        m_ls->setModuloSchedule(ii, (len + ii - 1) / ii, copies);
+    }
+
+    bool moduloScheduler::schedule() {
+        if (1 != m_ls->getBlocks().size()) return false;
+        if (!isSingleBlockLoop(m_ls->getBB()) || !buildGraph()) return false;
+
+        unsigned int flatLength = m_ls->length();
+        computeResMII();
+        computeRecMII();
+
+        for (unsigned int ii = std::max(m_resMII, m_recMII); ii < flatLength; ++ii) {
+            if (scheduleWithII(ii) && verify(ii)) {
+                apply(ii);
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // namespace
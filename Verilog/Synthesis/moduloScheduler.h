@@ -0,0 +1,186 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_MODULO_SCHEDULER_H
+#define LLVM_MODULO_SCHEDULER_H
+
+#include "llvm/Instructions.h"
+
+#include <vector>
+
+#include "listScheduler.h"
+
+using namespace llvm;
+
+using std::vector;
+
+namespace xVerilog {
+
+    /*
+     * A dependency between two opcodes of a loop:
+     *  start(to) >= start(from) + latency - II * distance
+     *  where distance is the number of iterations between the two.
+     */
+    struct moduloEdge {
+        unsigned int from;
+        unsigned int to;
+        int latency;
+        unsigned int distance;
+    };
+
+    /*
+     * Iterative modulo scheduling (Rau) of a loop which is a single
+     *  BasicBlock. A new iteration starts every II cycles, where II is
+     *  searched upwards from max(ResMII, RecMII). ResMII comes from the
+     *  number of resource units of each kind and RecMII from the chains
+     *  which go through the loop carried PHINodes.
+     *
+     *  The loop is emitted as a kernel of II states. The iteration in
+     *  stage s of the kernel only runs when bit s of the stage register is
+     *  set. Entering the loop sets bit 0 and the kernel shifts in a bit
+     *  after every pass, which makes the prologue. Nothing but the PHINode
+     *  copies comes after the branch, so when an iteration leaves the loop
+     *  the younger iterations are simply dropped and the epilogue is empty.
+     *  For this to be correct, the younger iterations may not store before
+     *  the exit and every value must be read before the next iteration
+     *  overwrites it. Schedules which break these rules are rejected and the
+     *  next II is tried.
+     */
+    class moduloScheduler {
+        public:
+            /*
+             * C'tor
+             * @param ls a scheduled loop block. Its table is replaced if the
+             *  loop is pipelined.
+             */
+            moduloScheduler(listScheduler* ls);
+
+            /*
+             * @return True if BB is a loop of one block: it ends with a
+             *  conditional branch to itself.
+             */
+            static bool isSingleBlockLoop(BasicBlock* BB);
+
+            /*
+             * Search for the smallest II which is shorter than the schedule
+             *  of the block and place the opcodes of one iteration in the
+             *  table of the listScheduler.
+             * @return true if the loop was pipelined
+             */
+            bool schedule();
+
+            /// @return the resource bound on II
+            unsigned int getResMII() {return m_resMII;}
+            /// @return the recurrence bound on II
+            unsigned int getRecMII() {return m_recMII;}
+
+        private:
+            /// a PHINode of the loop and the opcodes which make its next value
+            struct loopPhi {
+                PHINode* phi;
+                /// the opcode holding the PHINode
+                unsigned int op;
+                /// the opcodes which compute the value from the loop, may be empty
+                vector<unsigned int> producers;
+            };
+
+            /*
+             * Collect the opcodes, edges and PHINodes of the loop.
+             * @return false if this loop can not be pipelined
+             */
+            bool buildGraph();
+            void addEdge(unsigned int from, unsigned int to, int latency, unsigned int distance);
+            /*
+             * Collect the opcodes of the loop which produce the value of 'val'.
+             * Follows the wires which the lowering left outside of the block.
+             */
+            void getProducers(Value* val, vector<unsigned int>& producers, unsigned int depth = 0);
+
+            void computeResMII();
+            void computeRecMII();
+            /*
+             * @return true if the edges form a cycle which needs more than ii
+             *  cycles per iteration
+             */
+            bool hasPositiveCycle(unsigned int ii);
+
+            /*
+             * @return true if opcode i fits unit u at cycle t of the modulo
+             *  reservation table
+             */
+            bool fits(unsigned int i, unsigned int u, unsigned int t, unsigned int ii);
+            /*
+             * Mark the slots of opcode i on unit u at cycle t as taken by
+             *  'owner', or as free if owner is -1
+             */
+            void mark(unsigned int i, unsigned int u, unsigned int t, unsigned int ii, int owner);
+            /*
+             * Remove opcode i from the modulo schedule
+             */
+            void unschedule(unsigned int i, unsigned int ii);
+
+            /*
+             * Run the iterative modulo scheduler with a given II
+             * @return true if all of the opcodes were placed
+             */
+            bool scheduleWithII(unsigned int ii);
+            /*
+             * Check the register lifetimes, live out values and stores of the
+             *  modulo schedule in m_start
+             */
+            bool verify(unsigned int ii);
+            /*
+             * @return the cycle in which the PHINode takes its next value
+             */
+            unsigned int getPhiCopyCycle(const loopPhi& phi, unsigned int ii);
+            /*
+             * @return the length of one iteration, including the PHINode copies
+             */
+            unsigned int getIterationLength(unsigned int ii);
+            /*
+             * Replace the table of the listScheduler with the modulo schedule
+             */
+            void apply(unsigned int ii);
+
+            /// the scheduled block
+            listScheduler* m_ls;
+            /// the opcodes of the block
+            vector<abstractHWOpcode*> m_ops;
+            /// the opcode holding each instruction
+            OpcodeOwnerMap m_owners;
+            /// the index of each opcode
+            DenseMap<abstractHWOpcode*, unsigned int> m_index;
+            /// the length of each opcode, the distance to its dependents
+            vector<unsigned int> m_len;
+            /// the cycles of each opcode up to the last taken one
+            vector<unsigned int> m_extent;
+            /// the non empty offsets of each opcode in each stream
+            vector<vector<vector<unsigned int> > > m_mask;
+            /// the units each opcode may use
+            vector<vector<unsigned int> > m_units;
+            /// the units where opcodes never collide ('other')
+            vector<char> m_shared;
+            /// does the opcode write memory
+            vector<char> m_store;
+            /// is a value of the opcode used outside of the loop
+            vector<char> m_liveOut;
+            /// the edges into and out of each opcode
+            vector<moduloEdge> m_edges;
+            vector<vector<unsigned int> > m_in;
+            vector<vector<unsigned int> > m_out;
+            /// the loop carried PHINodes
+            vector<loopPhi> m_phis;
+            /// the index of the branch opcode
+            unsigned int m_branch;
+
+            unsigned int m_resMII;
+            unsigned int m_recMII;
+
+            /// the modulo schedule: start cycle and unit of each opcode
+            vector<int> m_start;
+            vector<unsigned int> m_unit;
+            /// the modulo reservation table: the opcode in each slot of each
+            /// stream of each unit, -1 if free
+            vector<vector<vector<int> > > m_mrt;
+    }; // class
+
+} //end of namespace
+#endif // h guard
@@ -0,0 +1,155 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "reservationTable.h"
+
+namespace xVerilog {
+
+    int reservationTable::findRun(unsigned int cycle) const {
+        // the last run which starts at or before 'cycle'
+        int node = m_root;
+        int best = -1;
+        while (node >= 0) {
+            if (m_runs[node].start <= cycle) {
+                best = node;
+                node = m_runs[node].right;
+            } else {
+                node = m_runs[node].left;
+            }
+        }
+        if (best >= 0 && cycle < m_runs[best].end) return best;
+        return -1;
+    }
+
+    int reservationTable::findFirstRun(int node, unsigned int cycle, unsigned int count) const {
+        while (node >= 0) {
+            const freeRun& run = m_runs[node];
+            if (run.longest < count) return -1;
+            if (run.start <= cycle) {
+                // everything on the left starts too early
+                node = run.right;
+                continue;
+            }
+            int left = findFirstRun(run.left, cycle, count);
+            if (left >= 0) return left;
+            if (run.end - run.start >= count) return node;
+            node = run.right;
+        }
+        return -1;
+    }
+
+    bool reservationTable::isTaken(unsigned int cycle) const {
+        return cycle < m_length && findRun(cycle) < 0;
+    }
+
+    unsigned int reservationTable::findFirstFit(unsigned int cycle, unsigned int count) const {
+        if (cycle >= m_length) return cycle;
+        // the run which holds the cycle may be long enough
+        int run = findRun(cycle);
+        if (run >= 0 && m_runs[run].end - cycle >= count) return cycle;
+        // or the first long enough run after it
+        run = findFirstRun(m_root, cycle, count);
+        if (run >= 0) return m_runs[run].start;
+        // or the end of the table, the run before it does not reach the end
+        return m_length;
+    }
+
+    void reservationTable::reserve(unsigned int cycle, const InstructionCycle& insts) {
+        if (!insts.empty()) {
+            InstructionCycle& cyc = m_cycles[cycle];
+            cyc.insert(cyc.end(), insts.begin(), insts.end());
+        }
+
+        if (cycle >= m_length) {
+            // the cycles between the end of the table and the new cycle are free
+            if (cycle > m_length) insertRun(m_length, cycle);
+            m_length = cycle + 1;
+            m_taken++;
+            return;
+        }
+
+        int run = findRun(cycle);
+        if (run < 0) return;
+        // split the free run around the cycle
+        unsigned int start = m_runs[run].start;
+        unsigned int end = m_runs[run].end;
+        eraseRun(start);
+        if (start < cycle) insertRun(start, cycle);
+        if (cycle + 1 < end) insertRun(cycle + 1, end);
+        m_taken++;
+    }
+
+    const InstructionCycle* reservationTable::getInstructions(unsigned int cycle) const {
+        map<unsigned int, InstructionCycle>::const_iterator it = m_cycles.find(cycle);
+        if (it == m_cycles.end()) return NULL;
+        return &it->second;
+    }
+
+    void reservationTable::update(int node) {
+        freeRun& run = m_runs[node];
+        run.longest = run.end - run.start;
+        if (run.left >= 0) run.longest = std::max(run.longest, m_runs[run.left].longest);
+        if (run.right >= 0) run.longest = std::max(run.longest, m_runs[run.right].longest);
+    }
+
+    void reservationTable::split(int node, unsigned int key, int& left, int& right) {
+        if (node < 0) {
+            left = right = -1;
+            return;
+        }
+        if (m_runs[node].start < key) {
+            split(m_runs[node].right, key, m_runs[node].right, right);
+            left = node;
+        } else {
+            split(m_runs[node].left, key, left, m_runs[node].left);
+            right = node;
+        }
+        update(node);
+    }
+
+    int reservationTable::merge(int left, int right) {
+        if (left < 0) return right;
+        if (right < 0) return left;
+        if (m_runs[left].priority > m_runs[right].priority) {
+            m_runs[left].right = merge(m_runs[left].right, right);
+            update(left);
+            return left;
+        }
+        m_runs[right].left = merge(left, m_runs[right].left);
+        update(right);
+        return right;
+    }
+
+    void reservationTable::insertRun(unsigned int start, unsigned int end) {
+        int node;
+        if (m_freeNodes.empty()) {
+            node = m_runs.size();
+            m_runs.push_back(freeRun());
+        } else {
+            node = m_freeNodes.back();
+            m_freeNodes.pop_back();
+        }
+        // xorshift, so the tables are built the same way on every run
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+
+        freeRun& run = m_runs[node];
+        run.start = start;
+        run.end = end;
+        run.priority = m_seed;
+        run.left = run.right = -1;
+        run.longest = end - start;
+
+        int left, right;
+        split(m_root, start, left, right);
+        m_root = merge(merge(left, node), right);
+    }
+
+    void reservationTable::eraseRun(unsigned int start) {
+        int left, mid, right;
+        split(m_root, start, left, right);
+        split(right, start + 1, mid, right);
+        if (mid >= 0) m_freeNodes.push_back(mid);
+        m_root = merge(left, right);
+    }
+
+} // namespace
@@ -0,0 +1,116 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_RESERVATION_TABLE_H
+#define LLVM_RESERVATION_TABLE_H
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include "abstractHWOpcode.h"
+
+using std::map;
+using std::vector;
+
+namespace xVerilog {
+
+    /*
+     * The cycles of one stream of a resource unit. Only the taken cycles
+     *  cost memory: the free cycles before the last taken cycle are kept as
+     *  runs of consecutive free cycles in a treap, and the instructions only
+     *  for the cycles which have some. Every node of the treap knows the
+     *  longest free run below it, so the first free window of any length
+     *  is found in logarithmic time. A cycle of a unit which is not
+     *  pipelined may be taken and have no instructions. There is no limit
+     *  on the length of the table, and none of the queries allocate.
+     */
+    class reservationTable {
+        public:
+            reservationTable():m_root(-1),m_length(0),m_taken(0),m_seed(0x9e3779b9) {}
+
+            /*
+             * @return true if 'cycle' is taken
+             */
+            bool isTaken(unsigned int cycle) const;
+
+            /*
+             * @return the first cycle which is not taken, starting at 'cycle'
+             */
+            unsigned int getNextFree(unsigned int cycle) const { return findFirstFit(cycle, 1); }
+
+            /*
+             * @return the first cycle, starting at 'cycle', which begins
+             *  'count' free cycles in a row
+             */
+            unsigned int findFirstFit(unsigned int cycle, unsigned int count) const;
+
+            /*
+             * Take 'cycle' and add 'insts' to its instructions
+             */
+            void reserve(unsigned int cycle, const InstructionCycle& insts);
+
+            /*
+             * @return the instructions of 'cycle', NULL if it has none
+             */
+            const InstructionCycle* getInstructions(unsigned int cycle) const;
+
+            /*
+             * @return the last taken cycle plus one, zero if the table is empty
+             */
+            unsigned int length() const { return m_length; }
+
+            /*
+             * @return the number of taken cycles
+             */
+            unsigned int takenSlots() const { return m_taken; }
+
+            /// the cycles which have instructions, in cycle order
+            typedef map<unsigned int, InstructionCycle>::const_iterator iterator;
+            iterator begin() const {return m_cycles.begin();}
+            iterator end() const {return m_cycles.end();}
+
+        private:
+            /// a run of free cycles and the treap below it
+            struct freeRun {
+                /// the first free cycle and the first taken cycle after it
+                unsigned int start, end;
+                /// the heap order of the treap
+                unsigned int priority;
+                /// the children, -1 if none
+                int left, right;
+                /// the longest run in this subtree
+                unsigned int longest;
+            };
+
+            /// @return the run which holds 'cycle', -1 if it is taken or
+            ///  after the last taken cycle
+            int findRun(unsigned int cycle) const;
+            /// @return the first run of the subtree 'node' which starts
+            ///  after 'cycle' and is at least 'count' long, -1 if none
+            int findFirstRun(int node, unsigned int cycle, unsigned int count) const;
+            /// recompute the longest run of 'node'
+            void update(int node);
+            /// split the subtree 'node' into the runs which start before 'key' and the rest
+            void split(int node, unsigned int key, int& left, int& right);
+            /// @return the subtree of all the runs of 'left' and then all of 'right'
+            int merge(int left, int right);
+            /// add the free run [start, end)
+            void insertRun(unsigned int start, unsigned int end);
+            /// remove the free run which starts at 'start'
+            void eraseRun(unsigned int start);
+
+            /// the nodes of the treap, erased nodes are reused
+            vector<freeRun> m_runs;
+            vector<int> m_freeNodes;
+            int m_root;
+            /// the last taken cycle plus one, everything after it is free
+            unsigned int m_length;
+            /// the number of taken cycles
+            unsigned int m_taken;
+            /// the state of the random priorities, the same for every table
+            unsigned int m_seed;
+            /// the instructions of the cycles which have some
+            map<unsigned int, InstructionCycle> m_cycles;
+    }; // class
+
+} //end of namespace
+#endif // h guard
@@ -0,0 +1,137 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "scheduleCache.h"
+
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/DataTypes.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+namespace xVerilog {
+
+    /// change this whenever the scheduler places opcodes differently
+    static const unsigned int CacheVersion = 3;
+
+    /// FNV-1a, 64 bit
+    static uint64_t hashString(const string& str) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned int i = 0; i < str.size(); ++i) {
+            hash ^= (unsigned char)str[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    scheduleCache::scheduleCache(const string& dir):m_dir(dir) {
+        sys::Path path(m_dir);
+        std::string error;
+        if (!path.exists() && path.createDirectoryOnDisk(true, &error)) {
+            std::cerr<<"Unable to create the schedule cache "<<m_dir<<": "<<error<<"\n";
+            abort();
+        }
+    }
+
+    string scheduleCache::getBlockKey(BasicBlock* BB, TargetData* TD,
+            const resourceConfig& config, const string& options) {
+        std::string text;
+        raw_string_ostream os(text);
+        os<<"version "<<CacheVersion<<"\n";
+        os<<"options "<<options<<"\n";
+        os<<"units "<<config.units_memport<<" "<<config.units_mul<<" "
+            <<config.units_div<<" "<<config.units_shl<<"\n";
+        os<<"delays "<<config.delay_memport<<" "<<config.delay_mul<<" "
+            <<config.delay_div<<" "<<config.delay_shl<<"\n";
+        os<<"intervals "<<config.ii_mul<<" "<<config.ii_div<<" "<<config.ii_shl<<"\n";
+        os<<"memory "<<config.mem_wordsize<<" "<<config.membus_size<<" "
+            <<config.inline_op_to_wire<<"\n";
+        os<<"clock "<<config.target_clock_ns<<"\n";
+        os<<"layout "<<TD->getStringRepresentation()<<"\n";
+        os<<*BB;
+        // With a target clock, an operation is chained into a cycle if the
+        // path through its operands fits the clock, and that path may start
+        // in other blocks. Add the operations of those blocks it goes through.
+        if (config.target_clock_ns > 0) {
+            set<Instruction*> visited;
+            vector<Instruction*> work;
+            for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) work.push_back(I);
+            while (!work.empty()) {
+                Instruction* inst = work.back();
+                work.pop_back();
+                for (User::op_iterator op = inst->op_begin(); op != inst->op_end(); ++op) {
+                    Instruction* operand = dyn_cast<Instruction>(*op);
+                    if (!operand || operand->getParent() == BB) continue;
+                    if (!abstractHWOpcode::isChainLink(operand, config)) continue;
+                    if (!visited.insert(operand).second) continue;
+                    os<<"chain "<<*operand<<"\n";
+                    work.push_back(operand);
+                }
+            }
+        }
+        // the branch of the block waits for the values of the PHIs it jumps to
+        for (succ_iterator si = succ_begin(BB), se = succ_end(BB); si != se; ++si) {
+            for (BasicBlock::iterator I = (*si)->begin(); isa<PHINode>(I); ++I) {
+                os<<*I<<"\n";
+            }
+        }
+        os.flush();
+
+        char key[17];
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)hashString(text));
+        return string(key);
+    }
+
+    string scheduleCache::getPath(const string& key) const {
+        return m_dir + "/" + key + ".sched";
+    }
+
+    bool scheduleCache::load(const string& key, SchedulePlacement& placement,
+            unsigned int& heuristicLength) const {
+        std::ifstream file(getPath(key).c_str());
+        if (!file) return false;
+
+        string magic;
+        unsigned int version = 0, count = 0;
+        file>>magic>>version;
+        if (!file || magic != "vcc-schedule" || version != CacheVersion) return false;
+        file>>heuristicLength>>count;
+        if (!file) return false;
+
+        placement.clear();
+        for (unsigned int i = 0; i < count; ++i) {
+            opcodePlacement p;
+            file>>p.unit>>p.cycle>>p.unitName;
+            if (!file) return false;
+            placement.push_back(p);
+        }
+        return true;
+    }
+
+    void scheduleCache::store(const string& key, const SchedulePlacement& placement,
+            unsigned int heuristicLength) const {
+        std::stringstream ss;
+        ss<<"vcc-schedule "<<CacheVersion<<"\n"<<heuristicLength<<"\n"<<placement.size()<<"\n";
+        for (SchedulePlacement::const_iterator it = placement.begin(); it != placement.end(); ++it) {
+            ss<<it->unit<<" "<<it->cycle<<" "<<it->unitName<<"\n";
+        }
+
+        // Write a unique temporary file and rename it, so readers never see a
+        // partially written schedule.
+        sys::Path tmp(getPath(key));
+        std::string error;
+        if (tmp.createTemporaryFileOnDisk(false, &error)) return;
+        {
+            std::ofstream file(tmp.str().c_str());
+            file<<ss.str();
+            if (!file) {
+                tmp.eraseFromDisk();
+                return;
+            }
+        }
+        if (tmp.renamePathOnDisk(sys::Path(getPath(key)), &error)) {
+            tmp.eraseFromDisk();
+        }
+    }
+
+} // namespace
@@ -0,0 +1,71 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_SCHEDULE_CACHE_H
+#define LLVM_SCHEDULE_CACHE_H
+
+#include "llvm/Function.h"
+#include "llvm/Target/TargetData.h"
+
+#include <string>
+
+#include "listScheduler.h"
+#include "../params.h"
+
+using namespace llvm;
+
+using std::string;
+
+namespace xVerilog {
+
+    /*
+     * An on disk cache of the schedules of basic blocks. Each schedule is
+     *  stored in its own file, named after a hash of everything the list
+     *  scheduler looks at: the IR of the block, the PHI nodes of its
+     *  successors, the data layout and the resource configuration.
+     *  Loading and storing only touch the file of one key, so different
+     *  threads may use the cache at the same time.
+     */
+    class scheduleCache {
+        public:
+            /*
+             * C'tor
+             * @param dir the directory of the cache files. It is created if
+             *  it does not exist.
+             */
+            scheduleCache(const string& dir);
+
+            /*
+             * @return the key of the schedule of BB. Must be called before the
+             *  block is lowered, since lowering changes the IR.
+             * @param options the scheduling options which change the schedule
+             */
+            static string getBlockKey(BasicBlock* BB, TargetData* TD,
+                    const resourceConfig& config, const string& options);
+
+            /*
+             * Read the schedule which was stored under 'key'
+             * @param heuristicLength set to the length of the heuristic
+             *  schedule of the block, see listScheduler::getHeuristicLength
+             * @return false if there is no valid schedule for this key
+             */
+            bool load(const string& key, SchedulePlacement& placement,
+                    unsigned int& heuristicLength) const;
+
+            /*
+             * Store the schedule of a block under 'key'. Failing to write
+             *  the cache is not an error, the next run will schedule again.
+             */
+            void store(const string& key, const SchedulePlacement& placement,
+                    unsigned int heuristicLength) const;
+
+        private:
+            /*
+             * @return the name of the cache file of 'key'
+             */
+            string getPath(const string& key) const;
+
+            /// the directory of the cache files
+            string m_dir;
+    }; // class
+
+} //end of namespace
+#endif // h guard
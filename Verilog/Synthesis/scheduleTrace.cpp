@@ -0,0 +1,151 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "scheduleTrace.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <iostream>
+
+namespace xVerilog {
+
+    static cl::opt<std::string>
+    SchedTrace("sched-trace", cl::desc("write the schedules and the placement decisions as a Chrome trace"),
+            cl::value_desc("file"), cl::init(""));
+
+    bool scheduleTrace::isEnabled() {
+        return !SchedTrace.empty();
+    }
+
+    scheduleTrace::scheduleTrace():m_first(true) {}
+
+    string scheduleTrace::quote(const string& text) {
+        std::stringstream ss;
+        ss<<"\"";
+        for (unsigned int i = 0; i < text.size(); ++i) {
+            unsigned char c = text[i];
+            if ('"' == c || '\\' == c) {
+                ss<<"\\"<<c;
+            } else if (c < 0x20) {
+                ss<<"\\u00"<<"0123456789abcdef"[c>>4]<<"0123456789abcdef"[c&15];
+            } else {
+                ss<<c;
+            }
+        }
+        ss<<"\"";
+        return ss.str();
+    }
+
+    string scheduleTrace::getUnitName(listScheduler* ls, unsigned int unit) {
+        resourceUnit* un = ls->getUnits()[unit];
+        return un->getName() + "_" + utostr(un->getId());
+    }
+
+    void scheduleTrace::beginEvent() {
+        m_events<<(m_first ? "\n" : ",\n");
+        m_first = false;
+    }
+
+    unsigned int scheduleTrace::getProcess(listScheduler* ls) {
+        const Function* F = ls->getBB()->getParent();
+        map<const Function*, unsigned int>::iterator it = m_processes.find(F);
+        if (it != m_processes.end()) return it->second;
+
+        unsigned int pid = m_processes.size() + 1;
+        m_processes[F] = pid;
+        m_offsets[F] = 0;
+
+        beginEvent();
+        m_events<<"{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": "<<pid
+            <<", \"args\": {\"name\": "<<quote(F->getName().str())<<"}}";
+        beginEvent();
+        m_events<<"{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": "<<pid
+            <<", \"tid\": 0, \"args\": {\"name\": \"blocks\"}}";
+        // the units are the same in all of the blocks of a function
+        for (unsigned int u = 0; u < ls->getUnits().size(); ++u) {
+            beginEvent();
+            m_events<<"{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": "<<pid<<", \"tid\": "<<u+1
+                <<", \"args\": {\"name\": "<<quote(getUnitName(ls, u))<<"}}";
+        }
+        return pid;
+    }
+
+    void scheduleTrace::addBlock(listScheduler* ls) {
+        unsigned int pid = getProcess(ls);
+        const Function* F = ls->getBB()->getParent();
+        unsigned int offset = m_offsets[F];
+        unsigned int length = ls->getStateCount();
+        string block = ls->getBB()->getName().str();
+        vector<abstractHWOpcode*>& ops = ls->getOpcodes();
+
+        beginEvent();
+        m_events<<"{\"name\": "<<quote(block)<<", \"cat\": \"block\", \"ph\": \"X\", \"pid\": "<<pid
+            <<", \"tid\": 0, \"ts\": "<<offset<<", \"dur\": "<<std::max(1U, length)
+            <<", \"args\": {\"length\": "<<ls->length()
+            <<", \"heuristic_length\": "<<ls->getHeuristicLength()
+            <<", \"initiation_interval\": "<<ls->getInitiationInterval()
+            <<", \"blocks\": "<<ls->getBlocks().size()
+            <<", \"opcodes\": "<<ops.size()<<"}}";
+
+        // The last decision of each opcode. A block may have been replayed
+        // from the cache or placed again by another engine, so the decisions
+        // only explain the opcodes which are still where they say.
+        const PlacementDecisionList& decisions = ls->getPlacementDecisions();
+        vector<const placementDecision*> decisionOf(ops.size(), (const placementDecision*)NULL);
+        for (PlacementDecisionList::const_iterator d = decisions.begin(); d != decisions.end(); ++d) {
+            if (d->op < ops.size()) decisionOf[d->op] = &*d;
+        }
+
+        SchedulePlacement placement = ls->getSchedulePlacement();
+        for (unsigned int i = 0; i < placement.size(); ++i) {
+            abstractHWOpcode* op = ops[i];
+            const opcodePlacement& p = placement[i];
+            const placementDecision* d = decisionOf[i];
+            if (d && (d->unit != p.unit || d->cycle != p.cycle)) d = NULL;
+
+            beginEvent();
+            m_events<<"{\"name\": "<<quote(op->getName() + " #" + utostr(i))
+                <<", \"cat\": \"opcode\", \"ph\": \"X\", \"pid\": "<<pid<<", \"tid\": "<<p.unit+1
+                <<", \"ts\": "<<offset + p.cycle<<", \"dur\": "<<std::max(1U, op->getLength())
+                <<", \"args\": {\"block\": "<<quote(block)
+                <<", \"op\": "<<i
+                <<", \"unit\": "<<quote(getUnitName(ls, p.unit))
+                <<", \"cycle\": "<<p.cycle
+                <<", \"must_be_last\": "<<(op->isMustBeLastOpcode() ? "true" : "false");
+            if (!d) {
+                m_events<<"}}";
+                continue;
+            }
+            m_events<<", \"ready\": "<<d->ready
+                <<", \"searched\": "<<(d->searched ? "true" : "false");
+            if (d->searched) {
+                m_events<<", \"earliest\": "<<d->earliest<<", \"candidates\": {";
+                for (unsigned int k = 0; k < d->candidates.size(); ++k) {
+                    m_events<<(k ? ", " : "")<<quote(getUnitName(ls, d->candidates[k].first))
+                        <<": "<<d->candidates[k].second;
+                }
+                // the unit with the fewest taken slots wins the tie
+                m_events<<"}, \"ties\": {";
+                for (unsigned int k = 0; k < d->ties.size(); ++k) {
+                    m_events<<(k ? ", " : "")<<quote(getUnitName(ls, d->ties[k].first))
+                        <<": "<<d->ties[k].second;
+                }
+                m_events<<"}";
+            }
+            m_events<<"}}";
+        }
+
+        m_offsets[F] = offset + length;
+    }
+
+    void scheduleTrace::write() {
+        std::string error;
+        raw_fd_ostream file(SchedTrace.c_str(), error);
+        if (!error.empty()) {
+            std::cerr<<"Unable to write "<<SchedTrace<<": "<<error<<"\n";
+            abort();
+        }
+        file<<"{\"displayTimeUnit\": \"ns\", \"otherData\": {\"time_unit\": \"one cycle is 1us\"},\n";
+        file<<"\"traceEvents\": ["<<m_events.str()<<"\n]}\n";
+    }
+
+} // namespace
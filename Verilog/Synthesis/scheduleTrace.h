@@ -0,0 +1,75 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_SCHEDULE_TRACE_H
+#define LLVM_SCHEDULE_TRACE_H
+
+#include "llvm/Function.h"
+
+#include <string>
+#include <sstream>
+#include <map>
+
+#include "listScheduler.h"
+
+using namespace llvm;
+
+using std::string;
+using std::map;
+
+namespace xVerilog {
+
+    /*
+     * Writes the schedules of the blocks, and why every opcode was placed
+     *  where it is, as a Chrome trace (the JSON of chrome://tracing and
+     *  Perfetto). Every function is a process and every resource unit is a
+     *  thread, one cycle is one microsecond and the blocks of a function
+     *  follow each other. The first thread of a function shows the blocks
+     *  and their length. Every opcode is shown where the final schedule
+     *  placed it. If the decision which put it there was recorded, it also
+     *  carries the units it could go to, the best cycle on each of them and
+     *  the taken slots of the units which tied. The trace is only recorded
+     *  if -sched-trace names a file.
+     */
+    class scheduleTrace {
+        public:
+            /*
+             * @return true if -sched-trace was given. The schedulers only
+             *  record their decisions if it was.
+             */
+            static bool isEnabled();
+
+            scheduleTrace();
+
+            /*
+             * Add the schedule of a block. The blocks of a function must be
+             *  added in order.
+             */
+            void addBlock(listScheduler* ls);
+
+            /*
+             * Write the trace to the file of -sched-trace
+             */
+            void write();
+
+        private:
+            /// @return the process of the function of 'ls', naming its threads
+            ///  after the units of 'ls' the first time
+            unsigned int getProcess(listScheduler* ls);
+            /// print 'text' as a JSON string
+            static string quote(const string& text);
+            /// @return the name of unit number 'unit' of 'ls'
+            static string getUnitName(listScheduler* ls, unsigned int unit);
+            /// start a new event
+            void beginEvent();
+
+            /// the events so far, without the enclosing array
+            std::stringstream m_events;
+            /// true if no event was written yet
+            bool m_first;
+            /// the process of each function
+            map<const Function*, unsigned int> m_processes;
+            /// the first free cycle of each function
+            map<const Function*, unsigned int> m_offsets;
+    }; // class
+
+} //end of namespace
+#endif // h guard
@@ -0,0 +1,18 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "schedulingArena.h"
+
+namespace xVerilog {
+
+    void schedulingArena::reset() {
+        // destruct in the reverse order of creation
+        while (!m_objects.empty()) {
+            std::pair<void*, destructorFn> obj = m_objects.back();
+            m_objects.pop_back();
+            obj.second(obj.first);
+        }
+        m_alloc.Reset();
+        m_bytes = 0;
+        m_wireDelays.clear();
+    }
+
+} // namespace
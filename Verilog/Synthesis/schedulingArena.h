@@ -0,0 +1,132 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_SCHEDULING_ARENA_H
+#define LLVM_SCHEDULING_ARENA_H
+
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/AlignOf.h"
+
+#include <new>
+#include <vector>
+#include <map>
+#include <utility>
+
+namespace llvm { class Instruction; }
+
+using namespace llvm;
+
+namespace xVerilog {
+
+    /// the delay from the registers to the output of an instruction and the
+    ///  number of chained operations on the way, see getWireDelays()
+    struct wireDelay {
+        double delay;
+        unsigned int length;
+    };
+    typedef std::map<Instruction*, wireDelay> WireDelayMap;
+
+    /*
+     * A bump allocator which owns all of the scheduling objects of a single
+     *  function (listScheduler, resourceUnit, abstractHWOpcode and
+     *  assignPartEntry). Objects are never freed one by one. When the arena
+     *  is reset (or destroyed) all of the objects are destructed in reverse
+     *  order of creation and the memory is released in one shot.
+     *
+     *  Since the VWriter resets the arena of each function right after
+     *  emitting it, and compiles at most -sched-threads functions at a time,
+     *  the peak memory of the scheduler is bounded by the largest functions
+     *  in the module and not by the size of the module:
+     *   peak ~ getBytesAllocated() + heap of the containers inside the
+     *          objects, which is linear in the number of instructions times
+     *          the number of cycles in the longest opcode of each block.
+     */
+    class schedulingArena {
+        public:
+            schedulingArena():m_bytes(0) {}
+            ~schedulingArena() { reset(); }
+
+            /*
+             * Allocate and construct an object of type T in the arena
+             */
+            template <class T> T* create() {
+                return record(new (allocate<T>()) T());
+            }
+            template <class T, class A1> T* create(const A1 &a1) {
+                return record(new (allocate<T>()) T(a1));
+            }
+            template <class T, class A1, class A2>
+                T* create(const A1 &a1, const A2 &a2) {
+                return record(new (allocate<T>()) T(a1, a2));
+            }
+            template <class T, class A1, class A2, class A3>
+                T* create(const A1 &a1, const A2 &a2, const A3 &a3) {
+                return record(new (allocate<T>()) T(a1, a2, a3));
+            }
+            template <class T, class A1, class A2, class A3, class A4>
+                T* create(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4) {
+                return record(new (allocate<T>()) T(a1, a2, a3, a4));
+            }
+            template <class T, class A1, class A2, class A3, class A4, class A5>
+                T* create(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4, const A5 &a5) {
+                return record(new (allocate<T>()) T(a1, a2, a3, a4, a5));
+            }
+            template <class T, class A1, class A2, class A3, class A4, class A5, class A6>
+                T* create(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4, const A5 &a5,
+                        const A6 &a6) {
+                return record(new (allocate<T>()) T(a1, a2, a3, a4, a5, a6));
+            }
+
+            /*
+             * Destruct all of the objects and release the memory
+             */
+            void reset();
+
+            /*
+             * @return the wire delay of every instruction of the function
+             *  which the lowering asked about, so that the chains of the
+             *  blocks are only walked once. Cleared by reset.
+             */
+            WireDelayMap& getWireDelays() { return m_wireDelays; }
+
+            /*
+             * @return the number of bytes handed out since the last reset
+             */
+            size_t getBytesAllocated() const { return m_bytes; }
+
+            /*
+             * @return the number of objects living in the arena
+             */
+            size_t getNumObjects() const { return m_objects.size(); }
+
+        private:
+            typedef void (*destructorFn)(void*);
+
+            template <class T> static void destruct(void *obj) {
+                static_cast<T*>(obj)->~T();
+            }
+
+            template <class T> void* allocate() {
+                m_bytes += sizeof(T);
+                return m_alloc.Allocate(sizeof(T), AlignOf<T>::Alignment);
+            }
+
+            template <class T> T* record(T* obj) {
+                m_objects.push_back(std::make_pair(static_cast<void*>(obj), &destruct<T>));
+                return obj;
+            }
+
+            // no copy
+            schedulingArena(const schedulingArena&);
+            schedulingArena& operator=(const schedulingArena&);
+
+            /// the memory of the objects
+            BumpPtrAllocator m_alloc;
+            /// all of the living objects and their destructors, by creation order
+            std::vector<std::pair<void*, destructorFn> > m_objects;
+            /// number of bytes handed out
+            size_t m_bytes;
+            /// see getWireDelays
+            WireDelayMap m_wireDelays;
+    }; // class
+
+} //end of namespace
+#endif // h guard
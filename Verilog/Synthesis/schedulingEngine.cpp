@@ -0,0 +1,24 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "schedulingEngine.h"
+#include "forceDirectedEngine.h"
+
+namespace xVerilog {
+
+    schedulingEngine* schedulingEngine::create(schedulerKind kind) {
+        switch (kind) {
+            case ListScheduling: return new listSchedulingEngine();
+            case ForceDirectedScheduling: return new forceDirectedEngine();
+        }
+        std::cerr<<"Unknown scheduler "<<kind<<"\n";
+        abort();
+        return NULL;
+    }
+
+    void listSchedulingEngine::schedule(listScheduler* ls) const {
+        // For each opcode, in priority order, place it in best location
+        for (unsigned int i = 0; i < ls->getOpcodes().size(); ++i) {
+            ls->placeOnBestUnit(i);
+        }
+    }
+
+} // namespace
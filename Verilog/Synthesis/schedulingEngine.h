@@ -0,0 +1,59 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_SCHEDULING_ENGINE_H
+#define LLVM_SCHEDULING_ENGINE_H
+
+#include <string>
+
+#include "listScheduler.h"
+
+using std::string;
+
+namespace xVerilog {
+
+    /// the scheduling algorithms which can place the opcodes of a block
+    enum schedulerKind {
+        ListScheduling,
+        ForceDirectedScheduling
+    };
+
+    /*
+     * An algorithm which places the abstractHWOpcodes of a listScheduler in
+     *  its resource units. The engine decides the cycle and the unit of each
+     *  opcode, the listScheduler holds the table, so the emission does not
+     *  depend on the engine which was used.
+     *  Engines have no state, one engine schedules all of the blocks, on any
+     *  number of threads.
+     */
+    class schedulingEngine {
+        public:
+            virtual ~schedulingEngine() {}
+
+            /*
+             * @return the name of the engine, as given on the command line
+             */
+            virtual string getName() const = 0;
+
+            /*
+             * Place all of the opcodes of 'ls'. The dependencies between the
+             *  opcodes are already known.
+             */
+            virtual void schedule(listScheduler* ls) const = 0;
+
+            /*
+             * @return a new engine of the given kind, owned by the caller
+             */
+            static schedulingEngine* create(schedulerKind kind);
+    }; // class
+
+    /*
+     * The greedy list scheduler: place the opcodes one by one, in priority
+     *  order, at the first cycle where a unit is free.
+     */
+    class listSchedulingEngine : public schedulingEngine {
+        public:
+            virtual string getName() const { return "list"; }
+            virtual void schedule(listScheduler* ls) const;
+    }; // class
+
+} //end of namespace
+#endif // h guard
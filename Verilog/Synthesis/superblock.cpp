@@ -0,0 +1,80 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "superblock.h"
+
+namespace xVerilog {
+
+    /// @return true if BB leaves the function
+    static bool isReturnBlock(BasicBlock* BB) {
+        TerminatorInst* term = BB->getTerminator();
+        return isa<ReturnInst>(term) || isa<UnreachableInst>(term);
+    }
+
+    BasicBlock* superblockFormation::getLikelySuccessor(BasicBlock* BB) {
+        BranchInst* br = dyn_cast<BranchInst>(BB->getTerminator());
+        if (!br) return NULL;
+        if (!br->isConditional()) return br->getSuccessor(0);
+
+        BasicBlock* s0 = br->getSuccessor(0);
+        BasicBlock* s1 = br->getSuccessor(1);
+
+        // loops iterate more often than they exit
+        if (Loop* L = m_loopInfo->getLoopFor(BB)) {
+            if (s0 == L->getHeader()) return s0;
+            if (s1 == L->getHeader()) return s1;
+            bool in0 = L->contains(s0);
+            bool in1 = L->contains(s1);
+            if (in0 && !in1) return s0;
+            if (in1 && !in0) return s1;
+        }
+
+        // the function returns once, every other path is more likely
+        bool ret0 = isReturnBlock(s0);
+        bool ret1 = isReturnBlock(s1);
+        if (ret1 && !ret0) return s0;
+        if (ret0 && !ret1) return s1;
+        return NULL;
+    }
+
+    bool superblockFormation::canExtend(BasicBlock* from, BasicBlock* to, BasicBlock* head) {
+        if (!to || m_placed.count(to)) return false;
+        // the trace is entered only at the head
+        if (to->getSinglePredecessor() != from) return false;
+        // a superblock does not cross a loop boundary
+        if (m_loopInfo->getLoopFor(to) != m_loopInfo->getLoopFor(head)) return false;
+        if (m_loopInfo->isLoopHeader(to)) return false;
+        // only branches are side exits
+        return isa<BranchInst>(to->getTerminator()) || isReturnBlock(to);
+    }
+
+    void superblockFormation::foldSingleEntryPHINodes(BasicBlock* BB) {
+        while (PHINode* phi = dyn_cast<PHINode>(BB->begin())) {
+            assert(1 == phi->getNumIncomingValues() && "PHINode of a block with one predecessor");
+            phi->replaceAllUsesWith(phi->getIncomingValue(0));
+            phi->eraseFromParent();
+        }
+    }
+
+    vector<BasicBlockTrace> superblockFormation::formTraces(Function& F) {
+        vector<BasicBlockTrace> traces;
+        m_placed.clear();
+
+        for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+            if (m_placed.count(BB)) continue;
+
+            BasicBlockTrace trace(1, BB);
+            m_placed.insert(BB);
+            while (trace.size() < m_maxBlocks) {
+                BasicBlock* last = trace.back();
+                if (!isa<BranchInst>(last->getTerminator())) break;
+                BasicBlock* next = getLikelySuccessor(last);
+                if (!canExtend(last, next, BB)) break;
+                foldSingleEntryPHINodes(next);
+                trace.push_back(next);
+                m_placed.insert(next);
+            }
+            traces.push_back(trace);
+        }
+        return traces;
+    }
+
+} // namespace
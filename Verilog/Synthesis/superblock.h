@@ -0,0 +1,78 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_SUPERBLOCK_H
+#define LLVM_SUPERBLOCK_H
+
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Analysis/LoopInfo.h"
+
+#include <vector>
+#include <set>
+
+using namespace llvm;
+
+using std::vector;
+using std::set;
+
+namespace xVerilog {
+
+    /// the blocks of a superblock, the head first
+    typedef vector<BasicBlock*> BasicBlockTrace;
+
+    /*
+     * Groups the blocks of a function into superblocks: traces along the
+     *  likely path, which are entered only at the head. A superblock is
+     *  scheduled as one block, so the trace does not pay a state transition
+     *  for every block, and the operations without side effects of a block
+     *  may start before the branch of the previous block. The branches in
+     *  the middle of the trace become side exits.
+     *
+     *  The likely successor comes from static heuristics: a loop takes its
+     *  back edge, does not leave the loop and does not branch to a block
+     *  which returns. A trace grows while the likely successor has no other
+     *  predecessor and is in the same loop. Blocks with side entrances are
+     *  not duplicated, the trace ends before them.
+     */
+    class superblockFormation {
+        public:
+            /*
+             * C'tor
+             * @param LI the loops of the function
+             * @param maxBlocks the longest trace
+             */
+            superblockFormation(LoopInfo* LI, unsigned int maxBlocks):
+                m_loopInfo(LI),m_maxBlocks(maxBlocks) {}
+
+            /*
+             * Group the blocks of F into traces. Every block is in exactly one
+             *  trace and the traces are in the order of their heads in F. The
+             *  PHINodes of the blocks after the head have one incoming value,
+             *  they are replaced by it.
+             */
+            vector<BasicBlockTrace> formTraces(Function& F);
+
+            /*
+             * @return the successor which the branch of BB likely takes, NULL
+             *  if the heuristics do not decide.
+             */
+            BasicBlock* getLikelySuccessor(BasicBlock* BB);
+
+        private:
+            /*
+             * @return true if the trace may go on from 'from' to 'to'
+             */
+            bool canExtend(BasicBlock* from, BasicBlock* to, BasicBlock* head);
+            /*
+             * Replace the PHINodes of a block with a single predecessor by
+             *  their incoming value
+             */
+            static void foldSingleEntryPHINodes(BasicBlock* BB);
+
+            LoopInfo* m_loopInfo;
+            unsigned int m_maxBlocks;
+            /// the blocks which are in a trace already
+            set<BasicBlock*> m_placed;
+    }; // class
+
+} //end of namespace
+#endif // h guard
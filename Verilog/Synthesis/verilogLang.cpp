@@ -7,6 +7,7 @@
 
 #include "verilogLang.h"
 #include "intrinsics.h"
+#include "backendStats.h"
 #include <algorithm> //JAWAD
 
 namespace xVerilog {
@@ -43,13 +44,13 @@ namespace xVerilog {
 
     string verilogLanguage::printBasicBlockDatapath(listScheduler *ls) {
         stringstream ss;
+        const scheduleView& view = ls->getScheduleView();
         // for each cycle in this basic block
-        for (unsigned int cycle=0; cycle<ls->length();cycle++) {
-            vector<Instruction*> inst = ls->getInstructionForCycle(cycle);
+        for (unsigned int cycle=0; cycle<view.getNumberOfCycles();cycle++) {
             // for each instruction in cycle, print it ...
-            for (vector<Instruction*>::iterator ii = inst.begin(); ii != inst.end(); ++ii) {
-                if (isInstructionDatapath(*ii)) {
-                    ss<<printInstruction(*ii, 0);
+            for (scheduleView::iterator ii = view.begin(cycle); ii != view.end(cycle); ++ii) {
+                if (isInstructionDatapath(ii->inst)) {
+                    ss<<printInstruction(ii->inst, 0);
                 }
             }
         }// for each cycle      
@@ -57,25 +58,35 @@ namespace xVerilog {
     }
 
     string verilogLanguage::printBasicBlockControl(listScheduler *ls) {
+        if (ls->getInitiationInterval()) return printPipelinedBlockControl(ls);
+
         stringstream ss;
         const string space("\t");
         string name = toPrintable(ls->getBB()->getName());
+        const scheduleView& view = ls->getScheduleView();
         // for each cycle in this basic block
-        for (unsigned int cycle=0; cycle<ls->length();cycle++) {
+        for (unsigned int cycle=0; cycle<view.getNumberOfCycles();cycle++) {
             ss<<""<<name<<cycle<<":\n"; //header
             ss<<"begin\n";
-            vector<Instruction*> inst = ls->getInstructionForCycle(cycle);
+            // the side exits of a superblock replace the next state
+            stringstream exits;
             // for each instruction in cycle, print it ...
-            for (vector<Instruction*>::iterator ii = inst.begin(); ii != inst.end(); ++ii) {
-                unsigned int id = ls->getResourceIdForInstruction(*ii);
-                if (!isInstructionDatapath(*ii)) {
-                    ss<<space<<printInstruction(*ii, id);
+            for (scheduleView::iterator ii = view.begin(cycle); ii != view.end(cycle); ++ii) {
+                if (isInstructionDatapath(ii->inst)) continue;
+                BranchInst* branch = dyn_cast<BranchInst>(ii->inst);
+                BasicBlock* next = branch ? ls->getTraceSuccessor(branch->getParent()) : NULL;
+                if (next) {
+                    string exit = printSideExit(branch, next);
+                    if (!exit.empty()) exits<<space<<exit;
+                } else {
+                    ss<<space<<printInstruction(ii->inst, ii->unit);
                 }
             }
 
-            if (cycle+1 != ls->length()) { 
+            if (cycle+1 != view.getNumberOfCycles()) { 
                 ss<<"\teip <= "<<name<<cycle+1<<";\n"; //header
             }
+            ss<<exits.str();
             ss<<"end\n";
         }// for each cycle      
 
@@ -83,6 +94,102 @@ namespace xVerilog {
     }
 
 
+    string verilogLanguage::printPipelinedBlockControl(listScheduler *ls) {
+        stringstream ss;
+        const string space("\t\t");
+        string name = toPrintable(ls->getBB()->getName());
+        unsigned int ii = ls->getInitiationInterval();
+        unsigned int stages = ls->getNumberOfStages();
+        const PhiCopyList& copies = ls->getPhiCopies();
+        const scheduleView& view = ls->getScheduleView();
+
+        // for each state of the kernel
+        for (unsigned int state=0; state<ii; state++) {
+            ss<<""<<name<<state<<":\n"; //header
+            ss<<"begin\n";
+            ss<<"\teip <= "<<name<<(state+1)%ii<<";\n";
+            // the next iteration enters the pipe
+            if (state+1 == ii) {
+                ss<<"\t"<<name<<"_stage <= {"<<name<<"_stage["<<stages-2<<":0],1'b1};\n";
+            }
+
+            // the cycle of each iteration in the pipe
+            for (unsigned int stage=0; stage<stages; stage++) {
+                unsigned int cycle = stage*ii + state;
+                if (cycle >= view.getNumberOfCycles()) continue;
+
+                stringstream body;
+                for (scheduleView::iterator it = view.begin(cycle); it != view.end(cycle); ++it) {
+                    if (isInstructionDatapath(it->inst)) continue;
+                    if (BranchInst* branch = dyn_cast<BranchInst>(it->inst)) {
+                        body<<space<<printPipelinedLoopExit(branch);
+                    } else {
+                        body<<space<<printInstruction(it->inst, it->unit);
+                    }
+                }
+                // the PHINodes take the values of the next iteration
+                for (PhiCopyList::const_iterator it = copies.begin(); it != copies.end(); ++it) {
+                    if (it->second != cycle) continue;
+                    Value *IV = it->first->getIncomingValueForBlock(ls->getBB());
+                    if (isa<UndefValue>(IV)) continue;
+                    body<<space<<GetValueName(it->first)<<" <= "<<evalValue(IV)<<";\n";
+                }
+
+                if (body.str().empty()) continue;
+                ss<<"\tif ("<<name<<"_stage["<<stage<<"]) begin\n";
+                ss<<body.str();
+                ss<<"\tend\n";
+            }
+            ss<<"end\n";
+        }// for each state
+
+        return ss.str();
+    }
+
+    string verilogLanguage::printPipelinedLoopExit(BranchInst* branch) {
+        stringstream ss;
+        BasicBlock* loop = branch->getParent();
+        string name = toPrintable(loop->getName());
+        // the loop continues on one successor and exits on the other
+        bool exitOnTrue = (branch->getSuccessor(0) != loop);
+        BasicBlock* exit = branch->getSuccessor(exitOnTrue ? 0 : 1);
+
+        if (exitOnTrue) {
+            ss << "if (" << evalValue(branch->getCondition()) << ") begin\n";
+        } else {
+            ss << "if (!(" << evalValue(branch->getCondition()) << ")) begin\n";
+        }
+        ss<<printPHICopiesForSuccessor(loop, exit);
+        // the younger iterations in the pipe are dropped
+        ss << "\t\teip <= " << toPrintable(exit->getName())<<"0;\n";
+        ss << "\t\t" << name << "_stage <= 1;\n";
+        ss << "\tend\n";
+        return ss.str();
+    }
+
+
+    string verilogLanguage::printSideExit(BranchInst* branch, BasicBlock* next) {
+        // falls through to the next block of the superblock
+        if (!branch->isConditional()) return "";
+        bool exitOnTrue = (branch->getSuccessor(0) != next);
+        BasicBlock* exit = branch->getSuccessor(exitOnTrue ? 0 : 1);
+        if (exit == next) return "";
+
+        stringstream ss;
+        if (exitOnTrue) {
+            ss << "if (" << evalValue(branch->getCondition()) << ") begin\n";
+        } else {
+            ss << "if (!(" << evalValue(branch->getCondition()) << ")) begin\n";
+        }
+        // nothing of this block is left after the branch, the PHINodes
+        // of the exit are all we need to set
+        ss<<printPHICopiesForSuccessor(branch->getParent(), exit);
+        ss << "\t\teip <= " << toPrintable(exit->getName())<<"0;\n";
+        ss << "\tend\n";
+        return ss.str();
+    }
+
+
     string verilogLanguage::printLoadInst(Instruction* inst, int unitNum, int cycleNum) {
         LoadInst* load = (LoadInst*) inst; // make the cast
         /*
@@ -156,10 +263,15 @@ namespace xVerilog {
 
 
     string verilogLanguage::printSelectInst(Instruction* inst) {
+        stringstream ss;
+        ss << GetValueName(inst) <<" <= "<<getSelectInst(inst);
+        return ss.str();
+    }
+
+    string verilogLanguage::getSelectInst(Instruction* inst) {
         stringstream ss;
         SelectInst* sel = (SelectInst*) inst; // make the cast
         // (cond) ? i_b : _ib;
-        ss << GetValueName(sel) <<" <= ";
         ss << "(" << evalValue(sel->getOperand(0)) << " ? ";
         ss << evalValue(sel->getOperand(1)) << " : ";
         ss << evalValue(sel->getOperand(2))<<")";
@@ -260,9 +372,14 @@ namespace xVerilog {
 
 
     string verilogLanguage::printCmpInst(Instruction* inst) {
+        stringstream ss;
+        ss << GetValueName(inst) << " <= " << getCmpInst(inst);
+        return ss.str();
+    }
+
+    string verilogLanguage::getCmpInst(Instruction* inst) {
         stringstream ss;
         CmpInst* cmp = (CmpInst*) inst; // make the cast
-        ss << GetValueName(inst) << " <= ";
         ss << "(";
         ss<< evalValue(cmp->getOperand(0));
 
@@ -494,10 +611,17 @@ namespace xVerilog {
         ss<<"\n\n";
         return ss.str();
     }
-    string verilogLanguage::getClockHeader() {
+    string verilogLanguage::getClockHeader(listSchedulerVector &lsv) {
         stringstream ss;
         ss<<"always @(posedge clk)\n begin\n  if (reset)\n   begin\n";
-        ss<<"    $display(\"@hard reset\");\n    eip<=0;\n    rdy<=0;\n   end\n\n";
+        ss<<"    $display(\"@hard reset\");\n    eip<=0;\n    rdy<=0;\n";
+        // the first iteration of each pipelined loop is in its first stage
+        for (listSchedulerVector::iterator it = lsv.begin(); it!=lsv.end(); ++it) {
+            if ((*it)->getInitiationInterval()) {
+                ss<<"    "<<toPrintable((*it)->getBB()->getName())<<"_stage<=1;\n";
+            }
+        }
+        ss<<"   end\n\n";
         return ss.str();
     }
     string verilogLanguage::getCaseHeader() {
@@ -526,21 +650,23 @@ namespace xVerilog {
         std::stringstream ss;
         // for each listScheduler of a basic block
         for (listSchedulerVector::iterator lsi=lsv.begin(); lsi!=lsv.end();++lsi) {
+            const scheduleView& view = (*lsi)->getScheduleView();
             // for each cycle in each LS
-            for (unsigned int cycle=0; cycle<(*lsi)->length();cycle++) {
-                vector<Instruction*> inst = (*lsi)->getInstructionForCycle(cycle);
+            for (unsigned int cycle=0; cycle<view.getNumberOfCycles();cycle++) {
                 // for each instruction in each cycle in each LS
-                for (vector<Instruction*>::iterator I = inst.begin(); I!=inst.end(); ++I) {
+                for (scheduleView::iterator it = view.begin(cycle); it!=view.end(cycle); ++it) {
+                    Instruction* I = it->inst;
                     // if has a return type, print it as a variable name
-                  if ((*I)->getType() != Type::getVoidTy((*I)->getContext())) {
+                  if (I->getType() != Type::getVoidTy(I->getContext())) {
                         ss << " ";
-                        ss << getTypeDecl((*I)->getType(), false, GetValueName(*I));
+                        ss << getTypeDecl(I->getType(), false, GetValueName(I));
                         ss << ";   /*local var*/\n";
                     }    
                 }
             }// for each cycle    
 
-            // Print all PHINode variables as well
+            // Print all PHINode variables as well. Only the head of a
+            // superblock has PHINodes.
             BasicBlock *bb= (*lsi)->getBB(); 
             for (BasicBlock::iterator bit = bb->begin(); bit != bb->end(); bit++) { 
                 if (dyn_cast<PHINode>(bit)) {
@@ -552,6 +678,12 @@ namespace xVerilog {
                     }     
                 }
             } 
+
+            // The stages of a pipelined loop which hold a valid iteration
+            if ((*lsi)->getInitiationInterval()) {
+                ss << " reg [" << (*lsi)->getNumberOfStages()-1 << ":0] ";
+                ss << toPrintable(bb->getName()) << "_stage;   /*pipeline stages*/\n";
+            }
         }// for each listScheduler
 
         return ss.str();
@@ -560,7 +692,7 @@ namespace xVerilog {
     unsigned int verilogLanguage::getNumberOfStates(listSchedulerVector &lsv){
         int numberOfStates = 0;
         for (listSchedulerVector::iterator it = lsv.begin(); it!=lsv.end();it++) {
-            numberOfStates += (*it)->length();
+            numberOfStates += (*it)->getStateCount();
         }
         return numberOfStates;
     }
@@ -569,6 +701,7 @@ namespace xVerilog {
         std::stringstream ss;
 
         unsigned int numberOfStates = getNumberOfStates(lsv);
+        NumStates += numberOfStates;
 
         // Instruction pointer of n bits, n^2 states
         unsigned int NumOfStateBits = (int) ceil(log(numberOfStates+1)/log(2))-1;
@@ -581,7 +714,7 @@ namespace xVerilog {
         //     // for example: 'define start 16'd0  ...
         for (listSchedulerVector::iterator it = lsv.begin(); it!=lsv.end(); it++) {
             // each cycle in the BB
-            for (unsigned int i=0;i<(*it)->length();i++) {
+            for (unsigned int i=0;i<(*it)->getStateCount();i++) {
                 ss << " parameter "<<toPrintable((*it)->getBB()->getName())<<i
                     <<" = "<<NumOfStateBits+1<<"'d"<<stateCounter<<";\n";
                 stateCounter++;
@@ -635,7 +768,7 @@ namespace xVerilog {
 
     string verilogLanguage::evalValue(Value* val) {
         if (Instruction* inst = dyn_cast<Instruction>(val)) {
-            if (abstractHWOpcode::isInstructionOnlyWires(inst)) return printInlinedInstructions(inst);
+            if (abstractHWOpcode::isInstructionOnlyWires(inst, m_config, &m_wireDelays)) return printInlinedInstructions(inst);
         }
         return GetValueName(val);
     }
@@ -654,6 +787,8 @@ namespace xVerilog {
                 ss<<evalValue(v0)<<" >> "<<evalValue(v1);
             } else if (calc->getOpcode() == Instruction::Add) {
                 ss<<evalValue(v0)<<" + "<<evalValue(v1);
+            } else if (calc->getOpcode() == Instruction::Sub) {
+                ss<<evalValue(v0)<<" - "<<evalValue(v1);
             } else if (calc->getOpcode() == Instruction::Xor) {
                 ss<<evalValue(v0)<<" ^ "<<evalValue(v1);
             } else if (calc->getOpcode() == Instruction::And) {
@@ -664,6 +799,12 @@ namespace xVerilog {
               std::cerr<<"Unknown Instruction "; calc->dump();
                 abort();
             }
+        } else if (dyn_cast<CmpInst>(inst)) { 
+            // a chained compare
+            ss <<  getCmpInst(inst);
+        } else if (dyn_cast<SelectInst>(inst)) { 
+            // a chained select
+            ss <<  getSelectInst(inst);
         } else if (dyn_cast<TruncInst>(inst)) { 
             // make the cast
             ss <<  evalValue(inst->getOperand(0));
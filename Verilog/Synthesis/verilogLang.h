@@ -63,11 +63,11 @@ namespace xVerilog {
     class verilogLanguage {
 
         public:
-            verilogLanguage(Module *module, Mangler *mang,TargetData* TD):m_module(module),m_mang(mang),TD(TD){//JAWAD
+            verilogLanguage(Module *module, Mangler *mang,TargetData* TD,
+                    const resourceConfig& config):m_module(module),m_mang(mang),TD(TD),m_config(config){//JAWAD
 
-                map<string, unsigned int> rt =  machineResourceConfig::getResourceTable();
-                m_pointerSize = rt["membus_size"];
-                m_memportNum =  rt["memport"];
+                m_pointerSize = config.membus_size;
+                m_memportNum =  config.units_memport;
             }
 
             // print a value as either an expression or as a variable name
@@ -78,6 +78,16 @@ namespace xVerilog {
 
             /// print list scheduler of a single BasicBlock
             string printBasicBlockControl(listScheduler *ls);
+            /*
+             * Print the kernel of a modulo scheduled loop. Each stage of
+             *  each kernel state is guarded by its bit of the stage register.
+             */
+            string printPipelinedBlockControl(listScheduler *ls);
+            /// print the branch which leaves a pipelined loop
+            string printPipelinedLoopExit(BranchInst* branch);
+            /// print the branch which leaves a superblock, 'next' is the
+            /// block of the superblock after the branch
+            string printSideExit(BranchInst* branch, BasicBlock* next);
             string printBasicBlockDatapath(listScheduler *ls);
 
             string printStoreInst(Instruction* inst, int unitNum, int cycleNum);
@@ -88,6 +98,7 @@ namespace xVerilog {
 
             string printReturnInst(Instruction* inst);
             string printSelectInst(Instruction* inst);
+            string getSelectInst(Instruction* inst);
 
             string printZxtInst(Instruction* inst);
 	    string printBitCastInst(Instruction* inst); //JAWAD
@@ -101,6 +112,7 @@ namespace xVerilog {
             string printBranchInst(Instruction* inst);
 
             string printCmpInst(Instruction* inst); 
+            string getCmpInst(Instruction* inst);
 
             string printPHINode(Instruction* inst); 
             string getGetElementPtrInst(Instruction* inst);
@@ -117,7 +129,7 @@ namespace xVerilog {
             string getTestBench(Function &F);
             string getTypeDecl(const Type *Ty, bool isSigned, const std::string &NameSoFar);
             string getMemDecl(Function *F);
-            string getClockHeader();
+            string getClockHeader(listSchedulerVector &lsv);
             string getClockFooter();
             string getCaseHeader();
             string getCaseFooter();
@@ -140,9 +152,13 @@ namespace xVerilog {
             Module* m_module;
             Mangler* m_mang;
 	    TargetData* TD; //JAWAD
+            /// the configuration of the execution units
+            const resourceConfig& m_config;
             /// The number of memory ports to render in this design
             unsigned int m_memportNum;
             unsigned int m_pointerSize;
+            /// the chained wires of the function, see evalValue
+            WireDelayMap m_wireDelays;
     };//class
 } //end of namespace
 #endif // h guard
@@ -0,0 +1,80 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#include "workQueue.h"
+
+#include "llvm/Config/config.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/Threading.h"
+
+#include <vector>
+#include <algorithm>
+
+#if defined(ENABLE_THREADS) && ENABLE_THREADS && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define VERILOG_HAVE_THREADS 1
+#endif
+
+using namespace llvm;
+
+namespace xVerilog {
+
+    namespace {
+        /// the state shared between the threads of a single run()
+        struct jobState {
+            workQueue::jobFunction fn;
+            void* context;
+            unsigned int jobs;
+            /// the number of jobs which were handed out
+            volatile sys::cas_flag next;
+        };
+
+        void* runJobs(void* arg) {
+            jobState* state = static_cast<jobState*>(arg);
+            while (true) {
+                // claim the next job
+                unsigned int job = sys::AtomicIncrement(&state->next) - 1;
+                if (job >= state->jobs) break;
+                state->fn(job, state->context);
+            }
+            return 0;
+        }
+    } // namespace
+
+    bool workQueue::isParallelSupported() {
+#ifdef VERILOG_HAVE_THREADS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void workQueue::run(unsigned int jobs, jobFunction fn, void* context) {
+        jobState state;
+        state.fn = fn;
+        state.context = context;
+        state.jobs = jobs;
+        state.next = 0;
+
+        unsigned int threads = std::min(m_threads, jobs);
+        if (threads <= 1 || !isParallelSupported()) {
+            runJobs(&state);
+            return;
+        }
+
+#ifdef VERILOG_HAVE_THREADS
+        // make the LLVM support library safe for threads
+        if (!llvm_is_multithreaded()) llvm_start_multithreaded();
+
+        // the calling thread is one of the workers
+        std::vector<pthread_t> workers(threads - 1);
+        unsigned int started = 0;
+        for (; started < workers.size(); ++started) {
+            if (pthread_create(&workers[started], NULL, runJobs, &state)) break;
+        }
+        runJobs(&state);
+        for (unsigned int i = 0; i < started; ++i) {
+            pthread_join(workers[i], NULL);
+        }
+#endif
+    }
+
+} // namespace
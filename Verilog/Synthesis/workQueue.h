@@ -0,0 +1,41 @@
+/* Nadav Rotem  - C-to-Verilog.com */
+#ifndef LLVM_WORK_QUEUE_H
+#define LLVM_WORK_QUEUE_H
+
+namespace xVerilog {
+
+    /*
+     * Runs a number of independent jobs on a fixed number of threads. The
+     *  jobs are handed out through an atomic counter so each job runs exactly
+     *  once, on any of the threads. The calling thread works as well and
+     *  run() returns only after all of the jobs are done.
+     *  If LLVM was built without thread support, all of the jobs run on the
+     *  calling thread, in order.
+     */
+    class workQueue {
+        public:
+            /// a job: the index of the job and the context given to run()
+            typedef void (*jobFunction)(unsigned int job, void* context);
+
+            /*
+             * C'tor
+             * @param threads the number of threads to use, including the caller
+             */
+            workQueue(unsigned int threads):m_threads(threads) {}
+
+            /*
+             * Run jobs 0..jobs-1 by calling fn(job, context)
+             */
+            void run(unsigned int jobs, jobFunction fn, void* context);
+
+            /*
+             * @return true if this build can run jobs in parallel
+             */
+            static bool isParallelSupported();
+
+        private:
+            unsigned int m_threads;
+    }; // class
+
+} //end of namespace
+#endif // h guard
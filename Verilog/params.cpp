@@ -7,10 +7,9 @@ namespace xVerilog {
  // the parser method for our integer parser 
 bool UnitNumParser::parse(cl::Option &O, llvm::StringRef &ArgName,
                           llvm::StringRef &Arg, unsigned &Val) {
-  const char *ArgStart = Arg.str().c_str();
-        char *End;
-        // Parse integer part, leaving 'End' pointing to the first non-integer char
-        Val = (unsigned)strtol(ArgStart, &End, 0);
+        // Parse the whole argument; getAsInteger returns true on error
+        if (Arg.getAsInteger(0, Val))
+            return O.error("'" + Arg + "' value invalid for integer argument!");
         //cerr<<"Parsing "<<ArgName<<" as "<<Val<<"\n";
         return false; // no error    
     }
@@ -40,9 +39,19 @@ bool UnitNumParser::parse(cl::Option &O, llvm::StringRef &ArgName,
     UnitNumParserOption 
         machineResourceConfig::delay_shl_num("delay_shl", cl::desc("delay cycles of shift units"), cl::value_desc("num"));
 
+    UnitNumParserOption 
+        machineResourceConfig::ii_mul_num("ii_mul", cl::desc("cycles between two operations on a multiply unit (1 if pipelined)"), cl::value_desc("num"));
+    UnitNumParserOption  
+        machineResourceConfig::ii_div_num("ii_div", cl::desc("cycles between two operations on a division unit (1 if pipelined)"), cl::value_desc("num"));
+    UnitNumParserOption 
+        machineResourceConfig::ii_shl_num("ii_shl", cl::desc("cycles between two operations on a shift unit (1 if pipelined)"), cl::value_desc("num"));
+
     UnitNumParserOption 
         machineResourceConfig::inline_wire("inline_op_to_wire", cl::desc("inline operations smaller then this bit number to operations which are done in the same cycle as wires"), cl::value_desc("num"));
 
+    cl::opt<double> 
+        machineResourceConfig::target_clock("target_clock_ns", cl::desc("chain operations into the same cycle while they fit this clock period, and pick the unit delays which meet it"), cl::value_desc("ns"), cl::init(0));
+
     //TODO:
     //Change these parameters to a true/false parameters rather
     //then numbers (zero or one)
@@ -52,25 +61,62 @@ bool UnitNumParser::parse(cl::Option &O, llvm::StringRef &ArgName,
 
     UnitNumParserOption machineResourceConfig::include_clocks("include_clocks", cl::desc("include clocks when considering the design score"), cl::value_desc("num"));
 
-    map<string, unsigned int> machineResourceConfig::getResourceTable() {
-        map<string,unsigned int> myMap;
-        myMap["memport"] = param_mem_num;
-        myMap["mul"] = param_mul_num;
-        myMap["div"] = param_div_num;
-        myMap["shl"] = param_shl_num;
-
-        myMap["mem_wordsize"] = mem_wordsize;
-        myMap["delay_memport"] = delay_mem_num;
-        myMap["delay_mul"] = delay_mul_num;
-        myMap["delay_div"] = delay_div_num;
-        myMap["delay_shl"] = delay_shl_num;
-        myMap["membus_size"] = membus_size;
-
-        myMap["inline_op_to_wire"] = inline_wire;
-        myMap["include_size"] = include_size;
-        myMap["include_freq"] = include_freq;
-        myMap["include_clocks"] = include_clocks;
-        return myMap;
+    resourceConfig machineResourceConfig::getResourceConfig() {
+        resourceConfig cfg;
+        cfg.units_memport = param_mem_num;
+        cfg.units_mul = param_mul_num;
+        cfg.units_div = param_div_num;
+        cfg.units_shl = param_shl_num;
+
+        cfg.mem_wordsize = mem_wordsize;
+        cfg.delay_memport = delay_mem_num;
+        cfg.delay_mul = delay_mul_num;
+        cfg.delay_div = delay_div_num;
+        cfg.delay_shl = delay_shl_num;
+        cfg.ii_mul = ii_mul_num;
+        cfg.ii_div = ii_div_num;
+        cfg.ii_shl = ii_shl_num;
+        cfg.membus_size = membus_size;
+
+        cfg.inline_op_to_wire = inline_wire;
+        cfg.target_clock_ns = target_clock;
+        // the unit delays which were not given are picked to meet the clock
+        if (target_clock > 0) {
+            if (!delay_mul_num.getNumOccurrences()) cfg.delay_mul = 0;
+            if (!delay_div_num.getNumOccurrences()) cfg.delay_div = 0;
+            if (!delay_shl_num.getNumOccurrences()) cfg.delay_shl = 0;
+        }
+        cfg.include_size = include_size;
+        cfg.include_freq = include_freq;
+        cfg.include_clocks = include_clocks;
+        return cfg;
+    }
+
+    resourceClass resourceConfig::getResourceClass(const std::string& unit) const {
+        resourceClass rc;
+        rc.latency = 0;
+        rc.ii = 1;
+        // Read the operands, write the result. The opcodes are lowered into
+        // exactly these two phases whatever their unit, so this is not an
+        // option and is the same for every class.
+        rc.phases = 2;
+
+        if ("mul" == unit) {
+            rc.latency = delay_mul;
+            rc.ii = ii_mul;
+        } else if ("div" == unit) {
+            rc.latency = delay_div;
+            rc.ii = ii_div;
+        } else if ("shl" == unit) {
+            rc.latency = delay_shl;
+            rc.ii = ii_shl;
+        } else if (0 == unit.find("mem_")) {
+            rc.latency = delay_memport;
+        }
+
+        // an operation can not hold its unit after it is done
+        rc.ii = std::max(1U, std::min(rc.ii, rc.latency + 1));
+        return rc;
     }
 
 } // namespace
@@ -38,13 +38,77 @@ namespace xVerilog {
    
     typedef cl::opt<unsigned, false, UnitNumParser> UnitNumParserOption;
 
+    /*
+     * The timing of a class of execution units. Each read or write phase of
+     * an operation is a stream of the unit. A unit which is not pipelined
+     * has one more stream, which an operation holds for the whole II.
+     */
+    struct resourceClass {
+        /// cycles from reading the operands to writing the result
+        unsigned int latency;
+        /// cycles between the starts of two operations on the same unit,
+        /// 1 if the unit is pipelined
+        unsigned int ii;
+        /// the number of read and write phases of an operation, two for
+        /// every class since that is how the opcodes are lowered
+        unsigned int phases;
+
+        /// @return the number of streams of a unit of this class
+        unsigned int getNumberOfStreams() const { return phases + (ii > 1 ? 1 : 0); }
+        /// @return the stream which is held for the II, if there is one
+        unsigned int getBusyStream() const { return phases; }
+    };
+
+    /*
+     * The hardware configuration of the design as given on the command line.
+     * It is read once when the backend is initialized and is then passed
+     * by reference to the scheduler, the opcodes, the scorer and the printer.
+     */
+    struct resourceConfig {
+        /// number of execution units of each kind
+        unsigned int units_memport;
+        unsigned int units_mul;
+        unsigned int units_div;
+        unsigned int units_shl;
+        /// pipeline stages of each kind of execution unit
+        unsigned int delay_memport;
+        unsigned int delay_mul;
+        unsigned int delay_div;
+        unsigned int delay_shl;
+        /// cycles between two operations on the same unit, zero or one if
+        /// the unit is pipelined
+        unsigned int ii_mul;
+        unsigned int ii_div;
+        unsigned int ii_shl;
+        /// the word size of the memory port
+        unsigned int mem_wordsize;
+        /// the size of pointers
+        unsigned int membus_size;
+        /// operations of this bitwidth or smaller are wires
+        unsigned int inline_op_to_wire;
+        /// the clock period in ns which simple operations are chained into,
+        /// zero if every operation takes a cycle
+        double target_clock_ns;
+        /// flags for the design score
+        unsigned int include_size;
+        unsigned int include_freq;
+        unsigned int include_clocks;
+
+        /*
+         * @return the timing of the execution units called 'unit': mul, div,
+         *  shl, mem_<array> or other
+         */
+        resourceClass getResourceClass(const std::string& unit) const;
+    };
+
     class machineResourceConfig {
         public:
             /*
              * Load all of the values into a structure which will be used by the scheduler
-             * to build the hardware description table.
+             * to build the hardware description table. Call this once, after the 
+             * command line was parsed.
              */
-            static map<string, unsigned int> getResourceTable();
+            static resourceConfig getResourceConfig();
     	    static string  chrsubst(string str , int ch, int ch2) { //JAWAD
 		char *s1   = new char [str.size()+1];  
 		strcpy (s1, str.c_str());
@@ -67,9 +131,13 @@ namespace xVerilog {
             static UnitNumParserOption delay_mul_num;
             static UnitNumParserOption delay_div_num;
             static UnitNumParserOption delay_shl_num;
+            static UnitNumParserOption ii_mul_num;
+            static UnitNumParserOption ii_div_num;
+            static UnitNumParserOption ii_shl_num;
             static UnitNumParserOption mem_wordsize;
             static UnitNumParserOption membus_size;
             static UnitNumParserOption inline_wire;
+            static cl::opt<double> target_clock;
             static UnitNumParserOption include_size;
             static UnitNumParserOption include_freq;
             static UnitNumParserOption include_clocks;
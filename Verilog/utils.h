@@ -4,6 +4,9 @@
 #define LLVM_SCHED_UTILS_H
 
 #include "llvm/Target/Mangler.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Support/CallSite.h"
 
 #include <iostream>
 #include <string>
@@ -54,6 +57,41 @@ namespace {
     }
 
 
+    /*
+     * The name prefix of the functions which the if-conversion calls
+     *  instead of a store in a branch: 
+     *  predicated_store_iN(value, pointer, predicate)
+     *  It writes to the memory only if the predicate is set.
+     */
+    const char* const PredicatedStorePrefix = "predicated_store";
+
+    /// the arguments of a predicated store, see getPredicatedStoreArgument
+    enum predicatedStoreArgument {
+        PredicatedStoreValue = 0,
+        PredicatedStorePointer = 1,
+        PredicatedStorePredicate = 2
+    };
+
+    /*
+     * @return true if inst is a predicated store. Its arguments are the
+     *  value and the pointer, like the operands of a StoreInst, and then
+     *  the predicate.
+     */
+    bool isPredicatedStore(const Instruction* inst) {
+        const CallInst* call = dyn_cast<CallInst>(inst);
+        if (!call || !call->getCalledFunction()) return false;
+        return call->getCalledFunction()->getName().startswith(PredicatedStorePrefix);
+    }
+
+    /*
+     * @return an argument of the predicated store inst. The operands of a
+     *  call also hold the called function, so read them through CallSite.
+     */
+    Value* getPredicatedStoreArgument(Instruction* inst, predicatedStoreArgument arg) {
+        assert(isPredicatedStore(inst) && "not a predicated store");
+        return CallSite(inst).getArgument(arg);
+    }
+
     string toPrintable(const string& in ){
         string VarName;
         VarName.reserve(in.capacity());
@@ -0,0 +1,36 @@
+/* The 10 rounds of AES-128 encryption of one block, one byte in each
+ * word. sbox is the S-box, key the 176 bytes of the expanded key and t
+ * holds the state between ShiftRows and MixColumns. */
+#define XTIME(x) ((((x) << 1) ^ ((((x) >> 7) & 1) * 0x1b)) & 0xFF)
+
+void aes(unsigned int* state, unsigned int* sbox, unsigned int* key, unsigned int* t) {
+    int round, i, c;
+
+    for (i = 0; i < 16; i++) state[i] ^= key[i];
+
+    for (round = 1; round <= 10; round++) {
+        /* SubBytes and ShiftRows */
+        for (i = 0; i < 16; i++) {
+            t[i] = sbox[state[(i + 4 * (i % 4)) % 16]];
+        }
+        /* MixColumns, except in the last round */
+        for (c = 0; c < 4; c++) {
+            unsigned int a0 = t[4 * c], a1 = t[4 * c + 1];
+            unsigned int a2 = t[4 * c + 2], a3 = t[4 * c + 3];
+            if (round != 10) {
+                unsigned int all = a0 ^ a1 ^ a2 ^ a3;
+                state[4 * c]     = a0 ^ all ^ XTIME(a0 ^ a1);
+                state[4 * c + 1] = a1 ^ all ^ XTIME(a1 ^ a2);
+                state[4 * c + 2] = a2 ^ all ^ XTIME(a2 ^ a3);
+                state[4 * c + 3] = a3 ^ all ^ XTIME(a3 ^ a0);
+            } else {
+                state[4 * c] = a0;
+                state[4 * c + 1] = a1;
+                state[4 * c + 2] = a2;
+                state[4 * c + 3] = a3;
+            }
+        }
+        /* AddRoundKey */
+        for (i = 0; i < 16; i++) state[i] ^= key[16 * round + i];
+    }
+}
@@ -0,0 +1,18 @@
+/* 3x3 convolution of a 16x16 image, the border is not written */
+#define W 16
+#define H 16
+
+void conv2d(int* image, int* kernel, int* out) {
+    int x, y, i, j;
+    for (y = 1; y < H - 1; y++) {
+        for (x = 1; x < W - 1; x++) {
+            int acc = 0;
+            for (i = -1; i <= 1; i++) {
+                for (j = -1; j <= 1; j++) {
+                    acc += kernel[(i + 1) * 3 + (j + 1)] * image[(y + i) * W + (x + j)];
+                }
+            }
+            out[y * W + x] = acc;
+        }
+    }
+}
@@ -0,0 +1,15 @@
+/* Bitwise CRC32 (IEEE 802.3) of 64 bytes, one byte in each word */
+#define LENGTH 64
+
+void crc32(unsigned int* data, unsigned int* result) {
+    unsigned int crc = 0xFFFFFFFF;
+    int i, bit;
+    for (i = 0; i < LENGTH; i++) {
+        crc ^= data[i] & 0xFF;
+        for (bit = 0; bit < 8; bit++) {
+            unsigned int mask = -(crc & 1);
+            crc = (crc >> 1) ^ (0xEDB88320 & mask);
+        }
+    }
+    *result = ~crc;
+}
@@ -0,0 +1,14 @@
+/* 16 tap FIR filter over a block of 64 samples */
+#define TAPS 16
+#define SAMPLES 64
+
+void fir(int* x, int* coeff, int* y) {
+    int n, k;
+    for (n = 0; n < SAMPLES; n++) {
+        int acc = 0;
+        for (k = 0; k < TAPS; k++) {
+            acc += coeff[k] * x[n + k];
+        }
+        y[n] = acc;
+    }
+}
@@ -0,0 +1,11 @@
+/* Histogram of 256 samples into 64 bins */
+#define SAMPLES 256
+#define BINS 64
+
+void histogram(unsigned int* data, unsigned int* hist) {
+    int i;
+    for (i = 0; i < BINS; i++) hist[i] = 0;
+    for (i = 0; i < SAMPLES; i++) {
+        hist[data[i] % BINS]++;
+    }
+}
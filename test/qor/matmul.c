@@ -0,0 +1,15 @@
+/* C = A * B of 8x8 matrices */
+#define N 8
+
+void matmul(int* A, int* B, int* C) {
+    int i, j, k;
+    for (i = 0; i < N; i++) {
+        for (j = 0; j < N; j++) {
+            int sum = 0;
+            for (k = 0; k < N; k++) {
+                sum += A[i * N + k] * B[k * N + j];
+            }
+            C[i * N + j] = sum;
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#!/bin/sh
+# Quality of results regression of the kernels in this directory.
+#
+# Every kernel is compiled with vcc.sh and the estimates of the design
+# scorer are read from the comments of the generated verilog: clocks to
+# finish, circuit delay, gate count, loop block percent and the number of
+# FSM states. They are compared with baseline.txt.
+#
+#   test/qor/run_qor.sh           compare with the baseline
+#   test/qor/run_qor.sh -update   record the results as the new baseline
+#   test/qor/run_qor.sh -priority compare the block orders of -sched-priority
+#
+# -priority compiles every kernel with -sched-priority=bfs and =critical and
+# prints the clocks to finish and the FSM states, the sum of the block
+# lengths, of both. It does not touch the baseline.
+#
+# Run it from the directory of vcc.sh. VCC selects another script and
+# QOR_OUT the directory of the verilog files and logs. A result which is
+# worse than the baseline by more than its tolerance, in percent, fails,
+# and so does a kernel which has no baseline. Until a baseline is recorded
+# the comparison is not run and the script exits with 77, so the gate is
+# neither green nor red before it has something to compare with.
+
+QOR_DIR=`dirname $0`
+VCC=${VCC:-./vcc.sh}
+QOR_OUT=${QOR_OUT:-/tmp/qor}
+BASELINE=$QOR_DIR/baseline.txt
+
+TOL_CLOCKS=${TOL_CLOCKS:-2}
+TOL_DELAY=${TOL_DELAY:-5}
+TOL_GATES=${TOL_GATES:-5}
+TOL_STATES=${TOL_STATES:-2}
+
+UPDATE=0
+if [ "$1" = "-update" ]; then UPDATE=1; fi
+
+mkdir -p $QOR_OUT
+
+# compile_kernels <results> <suffix> [synthesis flags]
+# Compile every kernel into $QOR_OUT/<kernel><suffix>.v and write a line of
+# results for each one
+compile_kernels() {
+    RES=$1
+    SUFFIX=$2
+    echo "# kernel clocks delay_ns gates loop_bb_percent states" > $RES
+    for SRC in $QOR_DIR/*.c; do
+        NAME=`basename $SRC .c`
+        OUT=$QOR_OUT/$NAME$SUFFIX.v
+        rm -f $OUT
+        VCC_SYNFLAGS="$3" sh $VCC $SRC $OUT > $QOR_OUT/$NAME$SUFFIX.log 2>&1
+        if [ ! -s $OUT ]; then
+            echo "$NAME: compilation failed, see $QOR_OUT/$NAME$SUFFIX.log"
+            echo "$NAME failed" >> $RES
+            continue
+        fi
+        # The clocks, gates and states of the modules add up, the slowest
+        # module sets the delay
+        awk -v name=$NAME -F'|' '
+            /Clocks to finish=/ { clocks += $2 }
+            /Design Freq=/      { if ($2 > delay) delay = $2 }
+            /Gates Count =/     { gates += $2 }
+            /Loop BB Percent =/ { loop += $2; modules++ }
+            /Number of states:/ { split($0, s, ":"); states += s[2] }
+            END { if (modules) loop /= modules;
+                  printf "%s %g %g %g %g %d\n", name, clocks, delay, gates, loop, states }
+        ' $OUT >> $RES
+    done
+}
+
+if [ "$1" = "-priority" ]; then
+    compile_kernels $QOR_OUT/bfs.txt .bfs -sched-priority=bfs
+    compile_kernels $QOR_OUT/critical.txt .critical -sched-priority=critical
+    echo "# kernel clocks(bfs critical) states(bfs critical)"
+    awk '
+        /^#/ { next }
+        FILENAME == ARGV[1] { clocks[$1] = $2; states[$1] = $6; next }
+        { printf "%s %s %s %s %s\n", $1, clocks[$1], $2, states[$1], $6 }
+    ' $QOR_OUT/bfs.txt $QOR_OUT/critical.txt
+    exit 0
+fi
+
+RESULTS=$QOR_OUT/results.txt
+compile_kernels $RESULTS ""
+
+if [ $UPDATE = 1 ]; then
+    cp $RESULTS $BASELINE
+    echo "Recorded the baseline in $BASELINE"
+    exit 0
+fi
+
+if [ `grep -cv '^#' $BASELINE` = 0 ]; then
+    echo "No baseline in $BASELINE, record one with -update on a built tree"
+    exit 77
+fi
+
+# Lower is better for every column but the loop block percent, which is
+# only reported
+awk -v tc=$TOL_CLOCKS -v td=$TOL_DELAY -v tg=$TOL_GATES -v ts=$TOL_STATES '
+    function check(kernel, what, old, new, tol) {
+        if (old == 0) return
+        change = (new - old) * 100 / old
+        if (change > tol) {
+            printf "%s: %s %g -> %g (+%.1f%%) FAIL\n", kernel, what, old, new, change
+            failed++
+        } else if (change < -tol) {
+            printf "%s: %s %g -> %g (%.1f%%) better\n", kernel, what, old, new, change
+        }
+    }
+    /^#/ { next }
+    FILENAME == ARGV[1] { base[$1] = $0; next }
+    {
+        if (!($1 in base)) {
+            printf "%s: FAIL no baseline, record one with -update\n", $1
+            failed++
+            next
+        }
+        split(base[$1], b, " ")
+        if ($2 == "failed") {
+            if (b[2] != "failed") { printf "%s: FAIL to compile\n", $1; failed++ }
+            next
+        }
+        if (b[2] == "failed") { printf "%s: compiles now\n", $1; next }
+        check($1, "clocks", b[2], $2, tc)
+        check($1, "delay_ns", b[3], $3, td)
+        check($1, "gates", b[4], $4, tg)
+        if ($5 != b[5]) printf "%s: loop_bb_percent %g -> %g\n", $1, b[5], $5
+        check($1, "states", b[6], $6, ts)
+        checked++
+    }
+    END {
+        printf "%d kernels compared, %d regressions\n", checked, failed
+        exit (failed > 0)
+    }
+' $BASELINE $RESULTS
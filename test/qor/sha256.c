@@ -0,0 +1,27 @@
+/* The 64 rounds of the SHA-256 compression of one block. w holds the
+ * expanded message schedule and k the round constants. */
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+void sha256(unsigned int* w, unsigned int* k, unsigned int* state) {
+    unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+    unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+    int i;
+    for (i = 0; i < 64; i++) {
+        unsigned int s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+        unsigned int ch = (e & f) ^ (~e & g);
+        unsigned int t1 = h + s1 + ch + k[i] + w[i];
+        unsigned int s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+        unsigned int maj = (a & b) ^ (a & c) ^ (b & c);
+        unsigned int t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
@@ -0,0 +1,28 @@
+/* Smith-Waterman local alignment score of two sequences of 16 symbols.
+ * H is the (N+1)x(N+1) score matrix, its first row and column are zero. */
+#define N 16
+#define MATCH 2
+#define MISMATCH -1
+#define GAP -1
+
+void smith_waterman(int* a, int* b, int* H, int* result) {
+    int i, j, best = 0;
+    for (i = 0; i <= N; i++) {
+        H[i] = 0;
+        H[i * (N + 1)] = 0;
+    }
+    for (i = 1; i <= N; i++) {
+        for (j = 1; j <= N; j++) {
+            int diag = H[(i - 1) * (N + 1) + (j - 1)] + (a[i - 1] == b[j - 1] ? MATCH : MISMATCH);
+            int up = H[(i - 1) * (N + 1) + j] + GAP;
+            int left = H[i * (N + 1) + (j - 1)] + GAP;
+            int score = 0;
+            if (diag > score) score = diag;
+            if (up > score) score = up;
+            if (left > score) score = left;
+            H[i * (N + 1) + j] = score;
+            if (score > best) best = score;
+        }
+    }
+    *result = best;
+}
@@ -0,0 +1,17 @@
+/* Sorts 8 values with Batcher's odd-even merge sorting network */
+#define CSWAP(a, b) { int lo = (a) < (b) ? (a) : (b); int hi = (a) < (b) ? (b) : (a); (a) = lo; (b) = hi; }
+
+void sortnet(int* in, int* out) {
+    int v0 = in[0], v1 = in[1], v2 = in[2], v3 = in[3];
+    int v4 = in[4], v5 = in[5], v6 = in[6], v7 = in[7];
+
+    CSWAP(v0, v1); CSWAP(v2, v3); CSWAP(v4, v5); CSWAP(v6, v7);
+    CSWAP(v0, v2); CSWAP(v1, v3); CSWAP(v4, v6); CSWAP(v5, v7);
+    CSWAP(v1, v2); CSWAP(v5, v6);
+    CSWAP(v0, v4); CSWAP(v1, v5); CSWAP(v2, v6); CSWAP(v3, v7);
+    CSWAP(v2, v4); CSWAP(v3, v5);
+    CSWAP(v1, v2); CSWAP(v3, v4); CSWAP(v5, v6);
+
+    out[0] = v0; out[1] = v1; out[2] = v2; out[3] = v3;
+    out[4] = v4; out[5] = v5; out[6] = v6; out[7] = v7;
+}
@@ -9,10 +9,16 @@ WRE="-inline_op_to_wire=4 "
 DBG="-include_size=1 -include_clocks=1 -include_freq=1"
 MEM="-mem_wordsize=32 -membus_size=16"
 SYNFLAGS="$UNT $DLY $WRE $DBG $MEM"
+# sweep the units and pipeline depths instead of the ones above, the Pareto frontier goes to dse.json
+#SYNFLAGS="$SYNFLAGS -dse-explore -dse-units=1,2,4 -dse-delays=1,3,5 -dse-workers=4 -dse-report=dse.json"
+# write the schedule of every block and why each opcode went where it did, for chrome://tracing
+#SYNFLAGS="$SYNFLAGS -sched-trace=sched.json"
+# more synthesis flags from the environment, test/qor/run_qor.sh uses them
+SYNFLAGS="$SYNFLAGS $VCC_SYNFLAGS"
 
 #OPTFLAGS="-unroll-threshold=20 -inline-threshold=4096 -inline -loopsimplify -loop-rotate -loop-unroll -std-compile-opts -indvars -simplifycfg" #-parallel_balance #-reduce_bitwidth -detect_arrays"
 OPTFLAGS="-unroll-threshold=512 -inline-threshold=4096 -inline -loop-simplify -loop-rotate -std-compile-opts -loop-unroll -indvars -simplifycfg" #-parallel_balance" #-reduce_bitwidth -detect_arrays"
-MYFLAGS= #"-parallel_balance -reduce_bitwidth " #-detect_arrays"
+MYFLAGS= #"-parallel_balance -reduce_bitwidth -if_convert " #-detect_arrays"
  
 rm -f $TMPFILE
 rm -f /tmp/dis.txt /tmp/dis1.txt /tmp/dis2.txt /tmp/dis3.txt /tmp/dis4.txt